@@ -0,0 +1,168 @@
+#include "benchmark.h"
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+
+struct Benchmark {
+    std::string name;
+    BenchFunction function;
+};
+
+struct BenchResult {
+    std::string name;
+    size_t iterations;
+    // per repetition
+    std::vector<double> ns_per_item;
+    double median, mean, stddev;
+};
+
+static std::vector<Benchmark> &registry() {
+    static std::vector<Benchmark> benchmarks;
+    return benchmarks;
+}
+
+void register_benchmark(const std::string &name, BenchFunction function) {
+    Benchmark benchmark;
+    benchmark.name = name;
+    benchmark.function = function;
+    registry().push_back(benchmark);
+}
+
+// seconds and items of one run of `iterations`
+static double time_run(Benchmark &benchmark, size_t iterations, size_t &items) {
+    BenchContext context;
+    context.iterations = iterations;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    benchmark.function(context);
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+    items = context.items ? context.items : iterations;
+    return std::chrono::duration<double>(end - start).count();
+}
+
+static BenchResult run(Benchmark &benchmark, double min_time, int repetitions) {
+    // grow the iteration count until a run is long enough to time reliably,
+    // which also serves as the warmup
+    size_t iterations = 1;
+    size_t items;
+    // one untimed iteration first, so setup a benchmark does lazily on its
+    // first run doesn't cut the calibration short
+    time_run(benchmark, 1, items);
+    while (true) {
+        double seconds = time_run(benchmark, iterations, items);
+        if (seconds >= min_time || iterations >= ((size_t)1 << 40)) {
+            break;
+        }
+        // aim a bit past min_time, growing at most 10x per round
+        double scale = seconds > 0 ? min_time*1.4 / seconds : 10.0;
+        iterations = std::max(iterations + 1, (size_t)(iterations * std::min(scale, 10.0)));
+    }
+
+    BenchResult result;
+    result.name = benchmark.name;
+    result.iterations = iterations;
+    for (int i=0; i<repetitions; i++) {
+        double seconds = time_run(benchmark, iterations, items);
+        result.ns_per_item.push_back(seconds * 1e9 / items);
+    }
+
+    std::vector<double> sorted = result.ns_per_item;
+    std::sort(sorted.begin(), sorted.end());
+    size_t n = sorted.size();
+    result.median = n % 2 ? sorted[n/2] : (sorted[n/2 - 1] + sorted[n/2]) / 2;
+    double sum = 0, squares = 0;
+    for (size_t i=0; i<n; i++) {
+        sum += sorted[i];
+    }
+    result.mean = sum / n;
+    for (size_t i=0; i<n; i++) {
+        squares += (sorted[i] - result.mean) * (sorted[i] - result.mean);
+    }
+    result.stddev = n > 1 ? sqrt(squares / (n - 1)) : 0;
+    return result;
+}
+
+static bool write_json(const char *path, std::vector<BenchResult> &results, double min_time, int repetitions) {
+    FILE *file = fopen(path, "w");
+    if (!file) {
+        fprintf(stderr, "could not write %s\n", path);
+        return false;
+    }
+    fprintf(file, "{\n  \"context\": {\"min_time\": %g, \"repetitions\": %d},\n  \"benchmarks\": [", min_time, repetitions);
+    for (size_t i=0; i<results.size(); i++) {
+        BenchResult &r = results[i];
+        fprintf(file, "%s\n    {\"name\": \"%s\", \"iterations\": %zu, \"ns_per_item\": %.4f, "
+                "\"ns_per_item_mean\": %.4f, \"ns_per_item_stddev\": %.4f, \"items_per_second\": %.1f, \"repetitions\": [",
+                i ? "," : "", r.name.c_str(), r.iterations, r.median, r.mean, r.stddev, 1e9 / r.median);
+        for (size_t j=0; j<r.ns_per_item.size(); j++) {
+            fprintf(file, "%s%.4f", j ? ", " : "", r.ns_per_item[j]);
+        }
+        fprintf(file, "]}");
+    }
+    fprintf(file, "\n  ]\n}\n");
+    return fclose(file) == 0;
+}
+
+static void print_usage(const char *program) {
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --filter <text>       only run benchmarks whose name contains text\n"
+        "  --repetitions <n>     timed runs per benchmark after the warmup (default 5)\n"
+        "  --min-time <seconds>  minimum length of a run (default 0.2)\n"
+        "  --json <path>         also write the results as JSON\n"
+        "  --list                list the benchmarks and exit\n",
+        program);
+}
+
+int run_benchmarks(int argc, char **argv) {
+    const char *filter = "";
+    const char *json_path = NULL;
+    int repetitions = 5;
+    double min_time = 0.2;
+    bool list = false;
+
+    for (int i=1; i<argc; i++) {
+        if (strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (strcmp(argv[i], "--repetitions") == 0 && i + 1 < argc) {
+            repetitions = std::max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--min-time") == 0 && i + 1 < argc) {
+            min_time = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            json_path = argv[++i];
+        } else if (strcmp(argv[i], "--list") == 0) {
+            list = true;
+        } else {
+            print_usage(argv[0]);
+            return strcmp(argv[i], "--help") == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+        }
+    }
+
+    std::vector<BenchResult> results;
+    if (!list) {
+        printf("%-36s %14s %12s %10s %16s\n", "benchmark", "iterations", "ns/item", "stddev", "items/s");
+    }
+    for (size_t i=0; i<registry().size(); i++) {
+        Benchmark &benchmark = registry()[i];
+        if (benchmark.name.find(filter) == std::string::npos) {
+            continue;
+        }
+        if (list) {
+            printf("%s\n", benchmark.name.c_str());
+            continue;
+        }
+        BenchResult result = run(benchmark, min_time, repetitions);
+        printf("%-36s %14zu %12.3f %10.3f %16.4g\n", result.name.c_str(), result.iterations,
+                result.median, result.stddev, 1e9 / result.median);
+        fflush(stdout);
+        results.push_back(result);
+    }
+
+    // a listing has no results to write
+    if (json_path && !list && !write_json(json_path, results, min_time, repetitions)) {
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
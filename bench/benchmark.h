@@ -0,0 +1,48 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+// handed to a benchmark body, which runs its operation `iterations` times and
+// reports how many items (samples, vertices, ...) that processed
+struct BenchContext {
+    size_t iterations = 1;
+    size_t items = 0;
+};
+
+typedef std::function<void(BenchContext &)> BenchFunction;
+
+// keep the compiler from optimizing a result away
+template <typename T>
+inline void do_not_optimize(const T &value) {
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    static volatile char sink;
+    sink = *(const volatile char *)&value;
+#endif
+}
+
+// add a benchmark to the run, usually from a static initializer
+void register_benchmark(const std::string &name, BenchFunction function);
+
+// run the registered benchmarks selected by argv, returns the exit status
+int run_benchmarks(int argc, char **argv);
+
+// registers a benchmark body at static initialization
+struct BenchRegistration {
+    BenchRegistration(const std::string &name, BenchFunction function) {
+        register_benchmark(name, function);
+    }
+};
+
+#define BENCH_CONCAT_(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_(a, b)
+#define BENCHMARK(name, function) \
+    static BenchRegistration BENCH_CONCAT(bench_registration_, __LINE__)(name, function)
+
+#endif // BENCHMARK_H
@@ -0,0 +1,367 @@
+#include "benchmark.h"
+#include "erosion.h"
+#include "heightfield.h"
+#include "noise_graph.h"
+#include "pnoise.h"
+#include "shoreline.h"
+#include "worley.h"
+#include <Eigen/Geometry>
+#include <algorithm>
+#include <math.h>
+#include <memory>
+#include <vector>
+
+using namespace Eigen;
+
+// the noise as the app sets it up
+static PNoise make_noise() {
+    PNoise noise;
+    noise.set_amplitude(2.0f);
+    return noise;
+}
+
+// walk a diagonal so successive samples land in different lattice cells
+static void bench_height2D(BenchContext &context) {
+    PNoise noise = make_noise();
+    float x = -50.0f, y = -30.0f;
+    for (size_t i=0; i<context.iterations; i++) {
+        do_not_optimize(noise.get_height2D(x, y));
+        x += 0.37f;
+        y += 0.11f;
+    }
+}
+BENCHMARK("pnoise/get_height2D", bench_height2D);
+
+static void bench_gradient2D(BenchContext &context) {
+    PNoise noise = make_noise();
+    for (size_t i=0; i<context.iterations; i++) {
+        do_not_optimize(noise.get_gradient2D(i, i >> 3));
+    }
+}
+BENCHMARK("pnoise/get_gradient2D", bench_gradient2D);
+
+// warped noise the way user code composes it, two warp fields from their own
+// noises and the noise sampled at the moved point
+static void bench_warped_composed(BenchContext &context) {
+    PNoise noise = make_noise();
+    PNoise warp_x, warp_y;
+    warp_x.set_seed(1);
+    warp_y.set_seed(2);
+    warp_x.set_wavelength(4.0f);
+    warp_y.set_wavelength(4.0f);
+    float x = -50.0f, y = -30.0f;
+    for (size_t i=0; i<context.iterations; i++) {
+        do_not_optimize(noise.get_height2D(x + 2*warp_x.get_height2D(x, y), y + 2*warp_y.get_height2D(x, y)));
+        x += 0.37f;
+        y += 0.11f;
+    }
+}
+BENCHMARK("pnoise/warped_composed", bench_warped_composed);
+
+// the same walk through the fused evaluator, 1024 points a call
+static void bench_warped_batch(BenchContext &context) {
+    PNoise noise = make_noise();
+    noise.set_warp(2.0f, 4.0f);
+    std::vector<float> x(1024), y(1024), heights(1024);
+    for (int i=0; i<1024; i++) {
+        x[i] = -50.0f + i*0.37f;
+        y[i] = -30.0f + i*0.11f;
+    }
+    size_t calls = (context.iterations + 1023) / 1024;
+    for (size_t i=0; i<calls; i++) {
+        noise.get_warped_heights2D(1024, &x[0], &y[0], &heights[0]);
+        do_not_optimize(heights[0]);
+    }
+    context.items = calls * 1024;
+}
+BENCHMARK("pnoise/warped_batch", bench_warped_batch);
+
+// the normal as App::initialize used to compute it, from two extra samples
+static void bench_normal_numeric(BenchContext &context) {
+    PNoise noise = make_noise();
+    float x = -50.0f, y = -30.0f;
+    for (size_t i=0; i<context.iterations; i++) {
+        Vector3f vert(x, y, noise.get_height2D(x, y));
+        Vector3f vertup = Vector3f(x, y+0.0005, noise.get_height2D(x, y+0.0005)) - vert;
+        Vector3f vertright = Vector3f(x+0.0005, y, noise.get_height2D(x+0.0005, y)) - vert;
+        do_not_optimize(vertright.cross(vertup).normalized());
+        x += 0.37f;
+        y += 0.11f;
+    }
+}
+BENCHMARK("normal/numeric", bench_normal_numeric);
+
+static void bench_normal_analytic(BenchContext &context) {
+    PNoise noise = make_noise();
+    float x = -50.0f, y = -30.0f;
+    for (size_t i=0; i<context.iterations; i++) {
+        Vector2f gradient;
+        float height = noise.get_height_gradient2D(x, y, gradient);
+        do_not_optimize(height);
+        do_not_optimize(Vector3f(-gradient[0], -gradient[1], 1).normalized());
+        x += 0.37f;
+        y += 0.11f;
+    }
+}
+BENCHMARK("normal/analytic", bench_normal_analytic);
+
+// a whole size x size grid of the noise at the app's 0.1 spacing, items are
+// grid points. Noise is anything Heightfield::generate takes
+template <typename Noise>
+static BenchFunction bench_grid(int size, Noise noise) {
+    return [size, noise](BenchContext &context) mutable {
+        Heightfield grid(size, size, -size*0.05f, -size*0.05f, 0.1f);
+        for (size_t i=0; i<context.iterations; i++) {
+            grid.generate(noise);
+            do_not_optimize(grid.heights[0]);
+        }
+        context.items = context.iterations * size * size;
+    };
+}
+
+// the app's noise warped, heights and normals from the fused evaluator
+static PNoise make_warped_noise() {
+    PNoise noise = make_noise();
+    noise.set_warp(2.0f, 4.0f);
+    return noise;
+}
+
+// cellular noise with cells a unit across
+static WorleyNoise make_worley(WorleyMode mode) {
+    WorleyNoise noise;
+    noise.set_mode(mode);
+    return noise;
+}
+
+BENCHMARK("grid/generate/64", bench_grid(64, make_noise()));
+BENCHMARK("grid/generate/256", bench_grid(256, make_noise()));
+BENCHMARK("grid/generate/1024", bench_grid(1024, make_noise()));
+BENCHMARK("grid/generate_warped/256", bench_grid(256, make_warped_noise()));
+BENCHMARK("worley/f1/256", bench_grid(256, make_worley(WORLEY_F1)));
+BENCHMARK("worley/f2_minus_f1/256", bench_grid(256, make_worley(WORLEY_F2_MINUS_F1)));
+
+// fbm continents with ridged mountains where a mask is high, clamped
+static NoiseGraph make_coast_graph() {
+    NoiseGraph graph;
+    PNoise base, ridges, mask;
+    base.set_wavelength(8.0f);
+    ridges.set_seed(2);
+    ridges.set_wavelength(4.0f);
+    mask.set_seed(3);
+    mask.set_wavelength(32.0f);
+    int x = graph.x(), y = graph.y();
+    int land = graph.smoothstep(graph.noise(x, y, mask), -0.1f, 0.2f);
+    int height = graph.mix(graph.fbm(x, y, base, 5), graph.ridged(x, y, ridges, 4), land);
+    graph.set_output(graph.clamp(graph.add(graph.multiply(height, graph.constant(2.0f)), graph.constant(-0.1f)), -1, 1));
+    return graph;
+}
+
+// a size x size grid of points at the app's 0.1 spacing
+static void grid_points(int size, std::vector<float> &x, std::vector<float> &y) {
+    x.resize(size*size);
+    y.resize(size*size);
+    for (int i=0; i<size*size; i++) {
+        x[i] = (i % size)*0.1f - size*0.05f;
+        y[i] = (i / size)*0.1f - size*0.05f;
+    }
+}
+
+// a single noise shaped by a chain of arithmetic: sharpened crests blended
+// in by the noise itself, scaled, raised towards +x and clamped. mostly
+// arithmetic, so it shows what keeping the intermediates in L1 saves
+static NoiseGraph make_shaped_graph() {
+    NoiseGraph graph;
+    PNoise base;
+    base.set_wavelength(8.0f);
+    int x = graph.x(), y = graph.y();
+    int n = graph.noise(x, y, base);
+    int sharp = graph.absolute(n);
+    sharp = graph.multiply(sharp, sharp);
+    int blend = graph.smoothstep(n, -0.3f, 0.3f);
+    int height = graph.mix(n, sharp, blend);
+    height = graph.add(graph.multiply(height, graph.constant(2.0f)), graph.constant(-0.1f));
+    height = graph.maximum(height, graph.multiply(x, graph.constant(0.01f)));
+    height = graph.minimum(height, graph.subtract(graph.constant(1.5f), graph.absolute(y)));
+    graph.set_output(graph.clamp(height, -1, 1));
+    return graph;
+}
+
+// a graph compiled and run a block at a time, items are grid points
+static BenchFunction bench_graph_program(int size, NoiseGraph (*make_graph)()) {
+    return [size, make_graph](BenchContext &context) {
+        NoiseProgram program;
+        program.compile(make_graph());
+        std::vector<float> x, y, heights(size*size);
+        grid_points(size, x, y);
+        for (size_t i=0; i<context.iterations; i++) {
+            program.evaluate(heights.size(), &x[0], &y[0], &heights[0]);
+            do_not_optimize(heights[0]);
+        }
+        context.items = context.iterations * heights.size();
+    };
+}
+BENCHMARK("graph/program/256", bench_graph_program(256, make_coast_graph));
+BENCHMARK("graph/program/1024", bench_graph_program(1024, make_coast_graph));
+BENCHMARK("graph/program_shaped/256", bench_graph_program(256, make_shaped_graph));
+BENCHMARK("graph/program_shaped/1024", bench_graph_program(1024, make_shaped_graph));
+
+// the same graph written as passes over whole arrays, the way user code
+// combined noises before
+static BenchFunction bench_graph_passes(int size) {
+    return [size](BenchContext &context) {
+        PNoise mask;
+        mask.set_seed(3);
+        mask.set_wavelength(32.0f);
+        std::vector<float> x, y;
+        grid_points(size, x, y);
+        size_t count = x.size();
+        std::vector<float> base(count), ridges(count), land(count), octave(count), heights(count);
+        for (size_t i=0; i<context.iterations; i++) {
+            std::fill(base.begin(), base.end(), 0.0f);
+            std::fill(ridges.begin(), ridges.end(), 0.0f);
+            for (int o=0; o<5; o++) {
+                PNoise noise;
+                noise.set_seed(o);
+                noise.set_wavelength(8.0f / (1 << o));
+                noise.set_amplitude(1.0f / (1 << o));
+                noise.get_heights2D(count, &x[0], &y[0], &octave[0]);
+                for (size_t k=0; k<count; k++) base[k] += octave[k];
+            }
+            for (int o=0; o<4; o++) {
+                PNoise noise;
+                noise.set_seed(2 + o);
+                noise.set_wavelength(4.0f / (1 << o));
+                noise.get_heights2D(count, &x[0], &y[0], &octave[0]);
+                for (size_t k=0; k<count; k++) {
+                    float ridge = 1 - 2*fabsf(octave[k]);
+                    ridges[k] += ridge*ridge / (1 << o);
+                }
+            }
+            mask.get_heights2D(count, &x[0], &y[0], &land[0]);
+            for (size_t k=0; k<count; k++) {
+                float t = std::min(std::max((land[k] + 0.1f) / 0.3f, 0.0f), 1.0f);
+                land[k] = t*t*(3 - 2*t);
+            }
+            for (size_t k=0; k<count; k++) {
+                float height = base[k] + (ridges[k] - base[k])*land[k];
+                heights[k] = std::min(std::max(height*2 - 0.1f, -1.0f), 1.0f);
+            }
+            do_not_optimize(heights[0]);
+        }
+        context.items = context.iterations * count;
+    };
+}
+BENCHMARK("graph/passes/256", bench_graph_passes(256));
+BENCHMARK("graph/passes/1024", bench_graph_passes(1024));
+
+// the shaped graph as passes over whole arrays, one per node
+static BenchFunction bench_graph_shaped_passes(int size) {
+    return [size](BenchContext &context) {
+        PNoise base;
+        base.set_wavelength(8.0f);
+        std::vector<float> x, y;
+        grid_points(size, x, y);
+        size_t count = x.size();
+        std::vector<float> n(count), sharp(count), blend(count), height(count), rise(count), edge(count);
+        for (size_t i=0; i<context.iterations; i++) {
+            base.get_heights2D(count, &x[0], &y[0], &n[0]);
+            for (size_t k=0; k<count; k++) sharp[k] = fabsf(n[k]);
+            for (size_t k=0; k<count; k++) sharp[k] = sharp[k]*sharp[k];
+            for (size_t k=0; k<count; k++) blend[k] = std::min(std::max((n[k] + 0.3f) / 0.6f, 0.0f), 1.0f);
+            for (size_t k=0; k<count; k++) blend[k] = blend[k]*blend[k]*(3 - 2*blend[k]);
+            for (size_t k=0; k<count; k++) height[k] = n[k] + (sharp[k] - n[k])*blend[k];
+            for (size_t k=0; k<count; k++) height[k] = height[k]*2 - 0.1f;
+            for (size_t k=0; k<count; k++) rise[k] = x[k]*0.01f;
+            for (size_t k=0; k<count; k++) height[k] = std::max(height[k], rise[k]);
+            for (size_t k=0; k<count; k++) edge[k] = 1.5f - fabsf(y[k]);
+            for (size_t k=0; k<count; k++) height[k] = std::min(height[k], edge[k]);
+            for (size_t k=0; k<count; k++) height[k] = std::min(std::max(height[k], -1.0f), 1.0f);
+            do_not_optimize(height[0]);
+        }
+        context.items = context.iterations * count;
+    };
+}
+BENCHMARK("graph/passes_shaped/256", bench_graph_shaped_passes(256));
+BENCHMARK("graph/passes_shaped/1024", bench_graph_shaped_passes(1024));
+
+// a size x size grid of the app's noise, generated on the first run so the
+// noise stays out of the timings. benches over a terrain keep their own
+// state next to it
+struct NoiseGridBench {
+    Heightfield grid;
+
+    // true on the call that generated the grid
+    bool generate(int size) {
+        if (!grid.heights.empty()) {
+            return false;
+        }
+        PNoise noise = make_noise();
+        grid = Heightfield(size, size, -size*0.05f, -size*0.05f, 0.1f);
+        grid.generate(noise, default_thread_pool());
+        return true;
+    }
+};
+
+// the grid and its shoreline field
+struct ShorelineBench : NoiseGridBench {
+    ShorelineField field;
+
+    void setup(int size, float max_distance) {
+        if (generate(size)) {
+            field.build(grid, 0.0f, max_distance, &default_thread_pool());
+        }
+    }
+};
+
+// distance to the coast at water level 0 over a size x size grid, unbounded
+// or within 2 units. items are grid points
+static BenchFunction bench_shoreline(int size, float max_distance) {
+    std::shared_ptr<ShorelineBench> bench(new ShorelineBench());
+    return [size, max_distance, bench](BenchContext &context) {
+        bench->setup(size, max_distance);
+        for (size_t i=0; i<context.iterations; i++) {
+            bench->field.build(bench->grid, 0.0f, max_distance, &default_thread_pool());
+            do_not_optimize(bench->field.distances[0]);
+        }
+        context.items = context.iterations * size * size;
+    };
+}
+BENCHMARK("shoreline/build/256", bench_shoreline(256, 0.0f));
+BENCHMARK("shoreline/build/1024", bench_shoreline(1024, 0.0f));
+BENCHMARK("shoreline/build_bounded/1024", bench_shoreline(1024, 2.0f));
+
+// one changed 64x64 tile of a 1024 x 1024 field bounded to 2 units, items are
+// the tile's points
+static BenchFunction bench_shoreline_tile() {
+    std::shared_ptr<ShorelineBench> bench(new ShorelineBench());
+    return [bench](BenchContext &context) {
+        bench->setup(1024, 2.0f);
+        for (size_t i=0; i<context.iterations; i++) {
+            bench->field.update(bench->grid, 512, 512, 576, 576, &default_thread_pool());
+            do_not_optimize(bench->field.distances[0]);
+        }
+        context.items = context.iterations * 64 * 64;
+    };
+}
+BENCHMARK("shoreline/update_tile/64", bench_shoreline_tile());
+
+// the grid to erode
+struct ErosionBench : NoiseGridBench {
+    Erosion erosion;
+};
+
+// erosion iterations over a size x size grid, items are grid points. the
+// grid keeps eroding from one run to the next
+static BenchFunction bench_erosion(int size) {
+    std::shared_ptr<ErosionBench> bench(new ErosionBench());
+    return [size, bench](BenchContext &context) {
+        bench->generate(size);
+        ErosionParameters parameters;
+        parameters.iterations = context.iterations;
+        bench->erosion.erode(bench->grid, parameters, &default_thread_pool());
+        do_not_optimize(bench->grid.heights[0]);
+        context.items = context.iterations * size * size;
+    };
+}
+BENCHMARK("erosion/iteration/512", bench_erosion(512));
+BENCHMARK("erosion/iteration/2048", bench_erosion(2048));
@@ -0,0 +1,162 @@
+#include "benchmark.h"
+#include "fft.h"
+#include "gerstner.h"
+#include "ocean_fft.h"
+#include "ocean_loop.h"
+#include <math.h>
+#include <stdio.h>
+#include <memory>
+#include <vector>
+
+// one inverse 2D transform of a size x size plane, items are points
+static BenchFunction bench_fft(int size) {
+    return [size](BenchContext &context) {
+        FFT2D fft(size);
+        std::vector<float> re((size_t)size*size, 0.5f), im((size_t)size*size, 0.25f);
+        for (size_t i=0; i<context.iterations; i++) {
+            fft.inverse(&re[0], &im[0]);
+            do_not_optimize(re[0]);
+        }
+        context.items = context.iterations * size * size;
+    };
+}
+BENCHMARK("fft/inverse/64", bench_fft(64));
+BENCHMARK("fft/inverse/256", bench_fft(256));
+BENCHMARK("fft/inverse/1024", bench_fft(1024));
+
+// a whole ocean frame: spectrum update and the three transforms, single
+// threaded or on the default pool. items are surface points
+static BenchFunction bench_ocean(int size, bool threaded) {
+    // drawing the spectrum takes longer than an update, so it is done once
+    // on the first run and kept out of the timings
+    std::shared_ptr<OceanFFT> ocean(new OceanFFT());
+    return [size, threaded, ocean](BenchContext &context) {
+        if (!ocean->is_ready()) {
+            OceanParameters parameters;
+            parameters.size = size;
+            ocean->setup(parameters);
+        }
+        ThreadPool *pool = threaded ? &default_thread_pool() : NULL;
+        for (size_t i=0; i<context.iterations; i++) {
+            ocean->update(i / 60.0f, pool);
+            do_not_optimize(ocean->heights[0]);
+        }
+        context.items = context.iterations * size * size;
+    };
+}
+BENCHMARK("ocean/update/64", bench_ocean(64, false));
+BENCHMARK("ocean/update/256", bench_ocean(256, false));
+BENCHMARK("ocean/update/1024", bench_ocean(1024, false));
+BENCHMARK("ocean/update_pool/256", bench_ocean(256, true));
+BENCHMARK("ocean/update_pool/1024", bench_ocean(1024, true));
+
+// playback of a baked loop of the same ocean, 64 frames of `bits` bit
+// samples. items are surface points
+static BenchFunction bench_ocean_loop(int size, int bits) {
+    std::shared_ptr<OceanLoop> loop(new OceanLoop());
+    return [size, bits, loop](BenchContext &context) {
+        if (!loop->is_ready()) {
+            OceanParameters parameters;
+            parameters.size = size;
+            parameters.loop_period = 8.0f;
+            // the mapping outlives the file's name
+            const char *path = "ocean_bench_loop.oblp";
+            OceanLoop::bake(parameters, 64, bits, path, &default_thread_pool());
+            loop->open(path);
+            remove(path);
+        }
+        for (size_t i=0; i<context.iterations; i++) {
+            loop->update(i / 60.0f);
+            do_not_optimize(loop->heights[0]);
+        }
+        context.items = context.iterations * size * size;
+    };
+}
+BENCHMARK("ocean_loop/update/256/8", bench_ocean_loop(256, 8));
+BENCHMARK("ocean_loop/update/256/16", bench_ocean_loop(256, 16));
+BENCHMARK("ocean_loop/update/1024/16", bench_ocean_loop(1024, 16));
+
+// positions and normals of a 64x64 patch under a bank of `count` waves,
+// items are points
+static BenchFunction bench_gerstner(int count) {
+    return [count](BenchContext &context) {
+        GerstnerBank bank;
+        for (int i=0; i<count; i++) {
+            GerstnerWave wave;
+            wave.direction = Eigen::Vector2f(cosf(i*0.7f), sinf(i*0.7f));
+            wave.wavelength = 0.5f + 0.4f*i;
+            wave.amplitude = 0.02f;
+            wave.steepness = 0.5f / count;
+            bank.add(wave);
+        }
+        const int points = 64*64;
+        std::vector<float> x(points), y(points), out[6];
+        for (int i=0; i<points; i++) {
+            x[i] = (i % 64)*0.1f;
+            y[i] = (i / 64)*0.1f;
+        }
+        for (int i=0; i<6; i++) {
+            out[i].resize(points);
+        }
+        for (size_t i=0; i<context.iterations; i++) {
+            bank.evaluate(points, &x[0], &y[0], i / 60.0f, &out[0][0], &out[1][0], &out[2][0],
+                    &out[3][0], &out[4][0], &out[5][0]);
+            do_not_optimize(out[2][0]);
+        }
+        context.items = context.iterations * points;
+    };
+}
+BENCHMARK("gerstner/evaluate/1", bench_gerstner(1));
+BENCHMARK("gerstner/evaluate/8", bench_gerstner(8));
+BENCHMARK("gerstner/evaluate/16", bench_gerstner(16));
+
+// surface queries at scattered world points, as buoyancy would issue them,
+// items are points
+static void fill_query(WaterQuery &query) {
+    query.clear();
+    for (int i=0; i<4096; i++) {
+        query.add(-5.0f + (i*37 % 4096)*0.0025f, -5.0f + (i*91 % 4096)*0.0025f);
+    }
+}
+
+static void bench_query_gerstner(BenchContext &context) {
+    GerstnerBank bank;
+    for (int i=0; i<8; i++) {
+        GerstnerWave wave;
+        wave.direction = Eigen::Vector2f(cosf(i*0.7f), sinf(i*0.7f));
+        wave.wavelength = 0.5f + 0.4f*i;
+        wave.amplitude = 0.02f;
+        wave.steepness = 0.1f;
+        bank.add(wave);
+    }
+    WaterQuery query;
+    fill_query(query);
+    for (size_t i=0; i<context.iterations; i++) {
+        bank.query(query, i / 60.0f);
+        do_not_optimize(query.height[0]);
+    }
+    context.items = context.iterations * query.size();
+}
+BENCHMARK("water_query/gerstner/8", bench_query_gerstner);
+
+// the surface of an ocean of the given size, set up and updated once on the
+// first run like bench_ocean's
+static BenchFunction bench_query_ocean(int size) {
+    std::shared_ptr<OceanFFT> ocean(new OceanFFT());
+    return [size, ocean](BenchContext &context) {
+        if (!ocean->is_ready()) {
+            OceanParameters parameters;
+            parameters.size = size;
+            ocean->setup(parameters);
+            ocean->update(1.0f);
+        }
+        WaterQuery query;
+        fill_query(query);
+        for (size_t i=0; i<context.iterations; i++) {
+            ocean->query(query);
+            do_not_optimize(query.height[0]);
+        }
+        context.items = context.iterations * query.size();
+    };
+}
+BENCHMARK("water_query/ocean/256", bench_query_ocean(256));
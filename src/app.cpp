@@ -1,16 +1,27 @@
 #include "app.h"
 #include "stdio.h"
-#include <stdarg.h>  // for va_start, etc
-#include <memory>    // for std::unique_ptr
 
 #include <GLFW/glfw3.h> // for glVertex3f, etc
 #include <Eigen/Geometry> // for cross product
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include "gl_state.h"
+#include "profiler.h"
 
-#define PI 3.14159265359
+// world units between two grid vertices
+#define GRID_SPACING 0.1f
+
+// world units covered by one tessellation patch side
+#define PATCH_SIZE 1.0f
+// tessellated edges are split until they are about this long on screen
+#define PIXELS_PER_EDGE 8.0f
 
 using namespace Eigen;
 
 void App::initialize() {
+    PROFILE_ZONE("initialize");
+
     // set up lights
     const GLfloat light_position0[] = { 0.0, 0.0, -10.0, 1.0 };
     const GLfloat light_diffuse0[] = { 0.1, 0.1, 0.1, 1.0 };
@@ -21,93 +32,129 @@ void App::initialize() {
 
     glClearColor (0.0, 0.0, 0.0, 0.0);
     glShadeModel (GL_FLAT);
-    glEnable(GL_LIGHTING);
+    gl_state.set_enabled(GL_LIGHTING, true);
 
     glLightfv(GL_LIGHT0, GL_POSITION, light_position0);
     glLightfv(GL_LIGHT0, GL_DIFFUSE, light_diffuse0);
-    glEnable(GL_LIGHT0);
+    gl_state.set_enabled(GL_LIGHT0, true);
 
     glLightfv(GL_LIGHT1, GL_POSITION, light_position1);
     glLightfv(GL_LIGHT1, GL_DIFFUSE, light_diffuse1);
     glLightfv(GL_LIGHT1, GL_SPECULAR, light_specular1);
-    glEnable(GL_LIGHT1);
+    gl_state.set_enabled(GL_LIGHT1, true);
 
-    glEnable(GL_DEPTH_TEST);
-    glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
+    gl_state.set_enabled(GL_DEPTH_TEST, true);
+    gl_state.polygon_mode(GL_LINE);
 
     // set up terrain
     noise.set_amplitude(2.0f);
 
-    for(float i=-width; i<=width+0.005; i+=0.1f) {
+    terrain = Heightfield(2*width/GRID_SPACING + 1.5f, 2*height/GRID_SPACING + 1.5f,
+            -width, -height, GRID_SPACING);
+    terrain.generate(noise);
+
+    for(int i=0; i<terrain.columns; i++) {
         // verticies
         std::vector<Eigen::Vector3f> vrow;
         // normals of verticies
         std::vector<Eigen::Vector3f> nrow;
 
-        for(float j=-height; j<=height+0.005; j+= 0.1f) {
-            Vector3f vert(i, j, noise.get_height2D(i, j));
+        for(int j=0; j<terrain.rows; j++) {
+            Vector3f vert(terrain.get_x(i), terrain.get_y(j), terrain.heights[terrain.index(i, j)]);
             //log("vert: (%f, %f, %f)\n", vert[0], vert[1], vert[2]);
 
-            // compute the normal by getting partial derivatives numerically
-            Vector3f vertup = Vector3f(i, j+0.0005, noise.get_height2D(i, j+0.0005)) - vert;
-            Vector3f vertright = Vector3f(i+0.0005, j, noise.get_height2D(i+0.0005, j)) - vert;
-            Vector3f norm = vertright.cross(vertup);
-            norm.normalize();
-
             vrow.push_back(vert);
-            nrow.push_back(norm);
+            nrow.push_back(terrain.normals[terrain.index(i, j)]);
         }
         vertices.push_back(vrow);
         normals.push_back(nrow);
     }
 
     // set up camera
-    camera_roll = 30.0f;
-    camera_pitch = 70.0f;
-
-    camera_position = Vector3f(0, 0, 0);
+    current_state = previous_state = SimState();
+    interpolate(1.0);
 }
 
 void App::update(double delta) {
+    previous_state = current_state;
+    CameraPose &pose = current_state.camera;
+
     float mvmt_speed = 20.0f;
     float cspeed = 0.7f;
     if (keys_pressed.up) {
         if (keys_pressed.shift) {
-            camera_position += Vector3f(0, cspeed, 0)*delta;
+            pose.position += Vector3f(0, cspeed, 0)*delta;
         } else {
-            camera_pitch += mvmt_speed*delta;
+            pose.pitch += mvmt_speed*delta;
         }
     }
     if (keys_pressed.down) {
         if (keys_pressed.shift) {
-            camera_position -= Vector3f(0, cspeed, 0)*delta;
+            pose.position -= Vector3f(0, cspeed, 0)*delta;
         } else {
-            camera_pitch -= mvmt_speed*delta;
+            pose.pitch -= mvmt_speed*delta;
         }
     }
     if (keys_pressed.left) {
         if (keys_pressed.shift) {
-            camera_position -= Vector3f(cspeed, 0, 0)*delta;
+            pose.position -= Vector3f(cspeed, 0, 0)*delta;
         } else {
-            camera_roll -= mvmt_speed*delta;
+            pose.roll -= mvmt_speed*delta;
         }
     }
     if (keys_pressed.right) {
         if (keys_pressed.shift) {
-            camera_position += Vector3f(cspeed, 0, 0)*delta;
+            pose.position += Vector3f(cspeed, 0, 0)*delta;
         } else {
-            camera_roll += mvmt_speed*delta;
+            pose.roll += mvmt_speed*delta;
         }
     }
 
-    wave_angle += 10.0*delta;
+    current_state.time += delta;
+}
+
+void App::set_camera(const CameraPose &pose) {
+    current_state.camera = pose;
+}
 
-    // shading angle uniform variable
-    GLint loc = glGetUniformLocation(program, "angle");
-    glUniform1f(loc, wave_angle*PI/180.0f);
+void App::interpolate(double alpha) {
+    const SimState &a = previous_state;
+    const SimState &b = current_state;
+    camera.roll = a.camera.roll + (b.camera.roll - a.camera.roll)*alpha;
+    camera.pitch = a.camera.pitch + (b.camera.pitch - a.camera.pitch)*alpha;
+    camera.position = a.camera.position + (b.camera.position - a.camera.position)*alpha;
+    camera.zoom = a.camera.zoom + (b.camera.zoom - a.camera.zoom)*alpha;
+    time = a.time + (b.time - a.time)*alpha;
 }
 
 void App::draw() {
+    PROFILE_ZONE("draw");
+
+    if (render_mode == RENDER_TESSELLATED) {
+        draw_tessellated();
+    } else {
+        draw_grid();
+    }
+}
+
+void App::draw_grid() {
+    shader.use();
+
+    if (use_gpu_mesh) {
+        use_waves(shader, shader_waves_version, true);
+        noise_compute.draw();
+        return;
+    }
+
+    // the FFT ocean or its baked loop replaces the waves rather than adding to them
+    bool fft_ocean = has_ocean();
+    use_waves(shader, shader_waves_version, !fft_ocean);
+    if (fft_ocean) {
+        update_surface();
+    }
+    const std::vector<std::vector<Vector3f> > &vertices = fft_ocean ? surface_vertices : this->vertices;
+    const std::vector<std::vector<Vector3f> > &normals = fft_ocean ? surface_normals : this->normals;
+
     // draw each quad
     for(int i=0; i<vertices.size()-1; i++) {
         for(int j=0; j<vertices[i].size()-1; j++) {
@@ -139,143 +186,253 @@ void App::draw() {
 
 }
 
-void log(const std::string fmt_str, ...) {
-    int final_n, n = fmt_str.size() * 2; /* reserve 2 times as much as the length of the fmt_str */
-    std::string str;
-    std::unique_ptr<char[]> formatted;
-    va_list ap;
-    while(1) {
-        formatted.reset(new char[n]); /* wrap the plain char array into the unique_ptr */
-        strcpy(&formatted[0], fmt_str.c_str());
-        va_start(ap, fmt_str);
-        final_n = vsnprintf(&formatted[0], n, fmt_str.c_str(), ap);
-        va_end(ap);
-        if (final_n < 0 || final_n >= n)
-            n += abs(final_n - n + 1);
-        else
-            break;
+void App::set_waves(const GerstnerBank &bank) {
+    waves = bank;
+    // the new bank may share a version number with the old one
+    shader_waves_version = tess_waves_version = 0;
+}
+
+void App::use_waves(ShaderProgram &program, unsigned &uploaded_version, bool enabled) {
+    gl_state.uniform1i(program.uniform("wave_count"), enabled ? waves.get_count() : 0);
+
+    // phases go up every frame, the same ones the CPU queries use
+    std::vector<float> phases;
+    waves.phase_offsets(time, phases);
+    if (waves.get_count() > 0) {
+        glUniform1fv(program.uniform("wave_phase"), waves.get_count(), &phases[0]);
+    }
+
+    // the bank rarely changes, so the arrays only go to GL when it does
+    if (uploaded_version != waves.get_version()) {
+        std::vector<float> data;
+        waves.pack_uniforms(data);
+        if (!data.empty()) {
+            glUniform4fv(program.uniform("waves"), data.size() / 4, &data[0]);
+        }
+        uploaded_version = waves.get_version();
     }
-    fputs(formatted.get(), stderr);
 }
 
-std::string App::loadFileToString(char const * const fname)
-{
-    std::ifstream ifile(fname);
-    std::string filetext;
+void App::query_water(WaterQuery &query) {
+    PROFILE_ZONE("query_water");
+
+    // whichever model draw() displaces the surface with
+    if (!has_ocean() || render_mode != RENDER_GRID || use_gpu_mesh) {
+        // the waves ride on the terrain like in the vertex shader, whose
+        // slopes enter the tangents before the normal is taken
+        waves.query(query, time, &terrain);
+        return;
+    }
 
-    while( ifile.good() ) {
-        std::string line;
-        std::getline(ifile, line);
-        filetext.append(line + "\n");
+    get_ocean().query(query);
+
+    // the ocean rides on the terrain, whose height comes from where the
+    // surface point sits at rest
+    for (size_t i=0; i<query.size(); i++) {
+        Vector2f gradient;
+        query.height[i] += terrain.sample(query.rest_x[i], query.rest_y[i], gradient);
+
+        // slopes add up, the normal is (-dz/dx, -dz/dy, 1)
+        float nz = query.normal_z[i];
+        Vector3f normal(query.normal_x[i]/nz - gradient[0], query.normal_y[i]/nz - gradient[1], 1);
+        normal.normalize();
+        query.normal_x[i] = normal[0];
+        query.normal_y[i] = normal[1];
+        query.normal_z[i] = normal[2];
     }
+}
 
-    return filetext;
+bool App::setup_ocean(int size) {
+    OceanParameters parameters;
+    parameters.size = size;
+    // one tile spans the whole grid
+    parameters.length = 2*width;
+    if (!ocean.setup(parameters)) {
+        return false;
+    }
+    surface_vertices = vertices;
+    surface_normals = normals;
+    log("fft ocean: %dx%d waves over %g units\n", size, size, parameters.length);
+    return true;
 }
 
-void App::setup_shaders() {
-    // create the program object outside so the rest of the program can reference it
-    program = glCreateProgram();
-
-    //// create the vertex shader
-    if (true) {
-        // grab the source of the vshader
-        std::string vshader_string = loadFileToString("src/vshader1.vert");
-        GLchar const *vshader_source = vshader_string.c_str();
-        GLint const vshader_length = vshader_string.size();
-        // grab the source of the fshader
-        std::string fshader_string = loadFileToString("src/fshader1.frag");
-        GLchar const *fshader_source = fshader_string.c_str();
-        GLint const fshader_length = fshader_string.size();
-
-        // create the shader object
-        GLenum vertex_shader;
-        GLenum fragment_shader;
-        vertex_shader = glCreateShader(GL_VERTEX_SHADER);
-        fragment_shader = glCreateShader(GL_FRAGMENT_SHADER);
-
-        // load in the source shader code
-        glShaderSource(vertex_shader, 1, &vshader_source, &vshader_length);
-        glShaderSource(fragment_shader, 1, &fshader_source, &fshader_length);
-
-        // compile the shader code
-        glCompileShader(vertex_shader);
-        // check that compiled correctly
-        GLint isCompiled = 0;
-        glGetShaderiv(vertex_shader, GL_COMPILE_STATUS, &isCompiled);
-        if(isCompiled == GL_FALSE)
-        {
-                GLint maxLength = 0;
-                glGetShaderiv(vertex_shader, GL_INFO_LOG_LENGTH, &maxLength);
-
-                //The maxLength includes the NULL character
-                std::vector<char> errorLog(maxLength);
-                glGetShaderInfoLog(vertex_shader, maxLength, &maxLength, &errorLog[0]);
-
-                //Provide the infolog in whatever manor you deem best.
-                for(int i=0;i<maxLength; i++) {
-                    std::cout << errorLog[i];
-                }
-                std::cout << std::endl;
-                //Exit with failure.
-                glDeleteShader(vertex_shader); //Don't leak the shader.
+bool App::setup_ocean_loop(const std::string &path) {
+    if (!ocean_loop.open(path)) {
+        return false;
+    }
+    surface_vertices = vertices;
+    surface_normals = normals;
+    log("ocean loop: %d frames of %dx%d over %g s from %s\n", ocean_loop.get_frames(),
+            ocean_loop.get_size(), ocean_loop.get_size(), ocean_loop.get_period(), path.c_str());
+    return true;
+}
+
+OceanSurface &App::get_ocean() {
+    if (ocean_loop.is_ready()) {
+        return ocean_loop;
+    }
+    return ocean;
+}
+
+void App::update_surface() {
+    if (ocean_loop.is_ready()) {
+        ocean_loop.update(time, &default_thread_pool());
+    } else {
+        ocean.update(time, &default_thread_pool());
+    }
+    OceanSurface &surface = get_ocean();
+
+    PROFILE_ZONE("displace_grid");
+    for(int i=0; i<vertices.size(); i++) {
+        for(int j=0; j<vertices[i].size(); j++) {
+            const Vector3f &vert = vertices[i][j];
+            Vector3f displacement;
+            Vector2f slope;
+            surface.sample(vert[0], vert[1], displacement, slope);
+            surface_vertices[i][j] = vert + displacement;
+
+            // the terrain and ocean slopes add up, the normal is (-dz/dx, -dz/dy, 1)
+            const Vector3f &n = normals[i][j];
+            Vector3f normal(n[0]/n[2] - slope[0], n[1]/n[2] - slope[1], 1);
+            surface_normals[i][j] = normal.normalized();
         }
-        glCompileShader(fragment_shader);
+    }
+}
+
+void App::setup_shaders() {
+    PROFILE_ZONE("setup_shaders");
 
-        GLint compiled;
+    shader.add_stage(GL_VERTEX_SHADER, "src/vshader1.vert");
+    shader.add_stage(GL_FRAGMENT_SHADER, "src/fshader1.frag");
 
-        glGetShaderiv(fragment_shader, GL_COMPILE_STATUS, &compiled);
-        if (compiled == GL_FALSE) {
-            GLint maxLength = 0;
-            glGetShaderiv(fragment_shader, GL_INFO_LOG_LENGTH, &maxLength);
+    if (!shader.build(SHADER_CACHE_DIR)) {
+        log("shaders not linked, falling back to fixed function\n");
+        return;
+    }
+    shader.use();
 
-            //The maxLength includes the NULL character
-            std::vector<char> errorLog(maxLength);
-            glGetShaderInfoLog(fragment_shader, maxLength, &maxLength, &errorLog[0]);
+    setup_tessellation();
 
-            //Provide the infolog in whatever manor you deem best.
-            for(int i=0;i<maxLength; i++) {
-                std::cout << errorLog[i];
-            }
-            std::cout << std::endl;
-            //Exit with failure.
-            glDeleteShader(fragment_shader); //Don't leak the shader.
-        } else {
-            std::cout << "compiled!" << std::endl;
-            // attach shader to program
-            glAttachShader(program, vertex_shader);
-            glAttachShader(program, fragment_shader);
-
-            // link and use program object
-            glLinkProgram(program);
-
-            GLint linked;
-            glGetProgramiv(program, GL_LINK_STATUS, &linked);
-            if (linked)
-            {
-                std::cout << "shaders linked!" << std::endl;
-                glUseProgram(program);
-            }
-            else
-            {
-                std::cout << "shaders not linked.." << std::endl;
-                GLint maxLength = 0;
-                glGetProgramiv(program, GL_INFO_LOG_LENGTH, &maxLength);
-
-                //The maxLength includes the NULL character
-                std::vector<GLchar> infoLog(maxLength);
-                glGetProgramInfoLog(program, maxLength, &maxLength, &infoLog[0]);
-
-                //We don't need the program anymore.
-                glDeleteProgram(program);
-                //Don't leak shaders either.
-                glDeleteShader(vertex_shader);
-
-                //Use the infoLog as you see fit.
-                for(int i=0;i<maxLength; i++) {
-                    std::cout << infoLog[i];
+    // the same terrain generated on the GPU, drawn instead of the CPU grid on demand
+    if (noise_compute.setup()) {
+        noise_compute.generate(noise, terrain);
+    }
+}
+
+void App::toggle_gpu_mesh() {
+    use_gpu_mesh = !use_gpu_mesh && noise_compute.is_ready();
+    log("terrain mesh: %s\n", use_gpu_mesh ? "compute shader" : "cpu");
+}
+
+void App::setup_tessellation() {
+    if (!glext.tessellation) {
+        log("tessellation needs OpenGL 4.0, only the grid is available\n");
+        return;
+    }
+
+    tess_shader.add_stage(GL_VERTEX_SHADER, "src/tess_ocean.vert");
+    tess_shader.add_stage(GL_TESS_CONTROL_SHADER, "src/tess_ocean.tesc");
+    tess_shader.add_stage(GL_TESS_EVALUATION_SHADER, "src/tess_ocean.tese");
+    tess_shader.add_stage(GL_FRAGMENT_SHADER, "src/tess_ocean.frag");
+    if (!tess_shader.build(SHADER_CACHE_DIR)) {
+        log("tessellation shaders not linked, only the grid is available\n");
+        return;
+    }
+
+    // upload the CPU heights, the texel (i, j) is the grid vertex (i, j)
+    int columns = vertices.size();
+    int rows = vertices[0].size();
+    std::vector<float> heights(columns*rows);
+    for(int i=0; i<columns; i++) {
+        for(int j=0; j<rows; j++) {
+            heights[j*columns + i] = vertices[i][j][2];
+        }
+    }
+
+    glGenTextures(1, &height_texture);
+    gl_state.bind_texture(height_texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, columns, rows, 0, GL_RED, GL_FLOAT, &heights[0]);
+
+    // a coarse grid of quad patches over the same area as the CPU grid,
+    // corners ordered counter-clockwise for the evaluation shader. every
+    // corner also carries the lowest and highest terrain height under its
+    // patch, for culling
+    std::vector<GLfloat> corners;
+    for(float i=-width; i<width-0.005; i+=PATCH_SIZE) {
+        for(float j=-height; j<height-0.005; j+=PATCH_SIZE) {
+            // the grid points of the cells the patch overlaps
+            int c0 = std::max(0, (int)floorf((i - terrain.origin_x) / terrain.spacing));
+            int c1 = std::min(terrain.columns - 1, (int)ceilf((i + PATCH_SIZE - terrain.origin_x) / terrain.spacing));
+            int r0 = std::max(0, (int)floorf((j - terrain.origin_y) / terrain.spacing));
+            int r1 = std::min(terrain.rows - 1, (int)ceilf((j + PATCH_SIZE - terrain.origin_y) / terrain.spacing));
+            float low = FLT_MAX, high = -FLT_MAX;
+            for(int r=r0; r<=r1; r++) {
+                for(int c=c0; c<=c1; c++) {
+                    low = std::min(low, terrain.heights[terrain.index(c, r)]);
+                    high = std::max(high, terrain.heights[terrain.index(c, r)]);
                 }
-                std::cout << std::endl;
+            }
+
+            const float quad[4][2] = {
+                { i, j }, { i+PATCH_SIZE, j }, { i+PATCH_SIZE, j+PATCH_SIZE }, { i, j+PATCH_SIZE }
+            };
+            for(int k=0; k<4; k++) {
+                corners.push_back(quad[k][0]);
+                corners.push_back(quad[k][1]);
+                corners.push_back(0.0f);
+                corners.push_back(low);
+                corners.push_back(high);
             }
         }
     }
+    patch_vertex_count = corners.size() / 5;
+
+    glGenBuffers(1, &patch_buffer);
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, patch_buffer);
+    glBufferData(GL_ARRAY_BUFFER, corners.size()*sizeof(GLfloat), &corners[0], GL_STATIC_DRAW);
+}
+
+void App::toggle_tessellation() {
+    if (render_mode == RENDER_TESSELLATED) {
+        render_mode = RENDER_GRID;
+    } else if (patch_buffer) {
+        render_mode = RENDER_TESSELLATED;
+    }
+    log("render mode: %s\n", render_mode == RENDER_TESSELLATED ? "tessellated" : "grid");
+}
+
+void App::draw_tessellated() {
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    tess_shader.use();
+    // only the phases and viewport change between frames, the cache drops the rest
+    use_waves(tess_shader, tess_waves_version, true);
+    gl_state.uniform2f(tess_shader.uniform("viewport"), viewport[2], viewport[3]);
+    gl_state.uniform1f(tess_shader.uniform("pixels_per_edge"), PIXELS_PER_EDGE);
+    gl_state.uniform1i(tess_shader.uniform("heightmap"), 0);
+    gl_state.uniform2f(tess_shader.uniform("heightmap_size"), vertices.size(), vertices[0].size());
+    gl_state.uniform2f(tess_shader.uniform("terrain_extent"), width, height);
+    float reach_horizontal, reach_vertical;
+    waves.get_reach(reach_horizontal, reach_vertical);
+    gl_state.uniform2f(tess_shader.uniform("wave_reach"), reach_horizontal, reach_vertical);
+
+    gl_state.bind_texture(height_texture);
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, patch_buffer);
+    // the corners, then the terrain height range of their patch
+    GLsizei stride = 5*sizeof(GLfloat);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_TEXTURE_COORD_ARRAY);
+    glVertexPointer(3, GL_FLOAT, stride, 0);
+    glTexCoordPointer(2, GL_FLOAT, stride, (const GLvoid *)(3*sizeof(GLfloat)));
+
+    glext.PatchParameteri(GL_PATCH_VERTICES, 4);
+    glDrawArrays(GL_PATCHES, 0, patch_vertex_count);
+
+    glDisableClientState(GL_TEXTURE_COORD_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
 }
@@ -1,13 +1,18 @@
 #ifndef APP_H
 #define APP_H
 
+#include "camera_path.h"
+#include "gerstner.h"
 #include "pnoise.h"
+#include "shader_program.h"
+#include "heightfield.h"
+#include "noise_compute.h"
+#include "ocean_fft.h"
+#include "ocean_loop.h"
 #include <Eigen/Core>
 #include <vector>
 #include <GLUT/glut.h> // Gluint
-
-#include <iostream>
-#include <fstream>
+#include "logger.h"
 
 struct Keys {
     bool up    = false;
@@ -18,24 +23,78 @@ struct Keys {
     bool shift = false;
 };
 
+// everything the fixed step simulation advances
+struct SimState {
+    CameraPose camera;
+    // seconds simulated
+    double time        = 0.0;
+};
+
+// how the surface is submitted to the GPU
+enum RenderMode {
+    // the fixed CPU grid, one quad per grid cell
+    RENDER_GRID,
+    // coarse patches refined by the tessellation shaders where they are large on screen
+    RENDER_TESSELLATED
+};
+
 class App {
     private:
         PNoise noise;
         int width, height;
-        float wave_angle = 0;
-        GLuint program;
+        // the last two simulation steps, rendering interpolates between them
+        SimState previous_state, current_state;
+        // simulated time of the frame being rendered
+        double time = 0;
+        ShaderProgram shader;
 
+        // the waves the shaders add to the terrain, and the bank version each
+        // program last received, the arrays are only uploaded on changes
+        GerstnerBank waves = GerstnerBank::default_bank();
+        unsigned shader_waves_version = 0, tess_waves_version = 0;
+
+        // set the wave uniforms of the current program, no waves if !enabled
+        void use_waves(ShaderProgram &program, unsigned &uploaded_version, bool enabled);
+
+        Heightfield terrain;
         std::vector<std::vector<Eigen::Vector3f> > vertices;
         std::vector<std::vector<Eigen::Vector3f> > normals;
 
-        std::string loadFileToString(char const * const fname);
+        // tessellated render mode, only available on GL 4.0+
+        RenderMode render_mode = RENDER_GRID;
+        ShaderProgram tess_shader;
+        GLuint patch_buffer = 0;
+        GLsizei patch_vertex_count = 0;
+        GLuint height_texture = 0;
+
+        // the terrain generated by the compute shader, drawn in place of the CPU grid
+        NoiseCompute noise_compute;
+        bool use_gpu_mesh = false;
+
+        // the FFT ocean added to the CPU grid in place of the shader's waves,
+        // or a baked loop of one played back in its place
+        OceanFFT ocean;
+        OceanLoop ocean_loop;
+        std::vector<std::vector<Eigen::Vector3f> > surface_vertices;
+        std::vector<std::vector<Eigen::Vector3f> > surface_normals;
+
+        // the loop when one is open, otherwise the FFT ocean
+        OceanSurface &get_ocean();
+        bool has_ocean() { return ocean_loop.is_ready() || ocean.is_ready(); }
+        // advance the ocean to the rendered time and displace the grid by it
+        void update_surface();
+
+        // set up the patch grid and heightmap texture for tessellation
+        void setup_tessellation();
+
+        void draw_grid();
+        void draw_tessellated();
 
     public:
         // struct for key input
         Keys keys_pressed;
-        // degrees
-        float camera_roll, camera_pitch;
-        Eigen::Vector3f camera_position;
+        // camera of the frame being rendered
+        CameraPose camera;
 
         // constructors
         App() {};
@@ -43,17 +102,43 @@ class App {
 
         // initialize the perlin noise
         void initialize();
-        // update the application by delta time
+        // advance the simulation by one fixed step of delta seconds
         void update(double delta);
+        // camera of the current step, for recording
+        const CameraPose &get_camera() { return current_state.camera; }
+        // move the camera of the current step, for replays and scripted runs
+        void set_camera(const CameraPose &pose);
+        // set the rendered state to alpha of the way from the previous step to the current one
+        void interpolate(double alpha);
         // draws everything in the application
         void draw();
 
         // set up the shaders
         void setup_shaders();
 
-};
+        // switch between the CPU grid and the tessellated surface
+        void toggle_tessellation();
+
+        // switch between the CPU generated grid and the compute shader one
+        void toggle_gpu_mesh();
 
-// log a formatted string to stderr
-void log(const std::string fmt_str, ...);
+        // the Gerstner waves drawn on the terrain, evaluate them for the
+        // surface on screen
+        GerstnerBank &get_waves() { return waves; }
+        void set_waves(const GerstnerBank &bank);
+
+        // heights and normals of the surface being drawn above the query's
+        // points: the terrain plus the waves or the FFT ocean, at the time
+        // of the frame being rendered
+        void query_water(WaterQuery &query);
+
+        // animate the grid with an FFT ocean of size x size waves, false if
+        // the size isn't a power of two between 64 and 1024
+        bool setup_ocean(int size);
+        // animate the grid with a loop baked by Ocean-breeze-ocean-bake,
+        // false if the file can't be opened
+        bool setup_ocean_loop(const std::string &path);
+
+};
 
 #endif // APP_H
@@ -0,0 +1,82 @@
+#include "camera_path.h"
+#include <math.h>
+#include <stdio.h>
+
+#define PI 3.14159265359
+
+static const char *PATH_HEADER = "ocean-breeze camera path 1";
+
+bool CameraPath::save(const std::string &path) {
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    // %.9g round trips floats exactly, so replays match the recording
+    fprintf(file, "%s\nstep %.17g\n", PATH_HEADER, step);
+    for (size_t i=0; i<poses.size(); i++) {
+        const CameraPose &pose = poses[i];
+        fprintf(file, "%.9g %.9g %.9g %.9g %.9g %.9g\n", pose.roll, pose.pitch,
+                pose.position[0], pose.position[1], pose.position[2], pose.zoom);
+    }
+    return fclose(file) == 0;
+}
+
+bool CameraPath::load(const std::string &path) {
+    FILE *file = fopen(path.c_str(), "r");
+    if (!file) {
+        return false;
+    }
+
+    char header[64];
+    double file_step = 0;
+    bool ok = fgets(header, sizeof(header), file)
+        && std::string(header) == std::string(PATH_HEADER) + "\n"
+        && fscanf(file, " step %lf", &file_step) == 1 && file_step > 0;
+
+    std::vector<CameraPose> file_poses;
+    CameraPose pose;
+    while (ok && fscanf(file, "%f %f %f %f %f %f", &pose.roll, &pose.pitch,
+                &pose.position[0], &pose.position[1], &pose.position[2], &pose.zoom) == 6) {
+        file_poses.push_back(pose);
+    }
+    // anything left over is a malformed line
+    ok = ok && feof(file);
+    fclose(file);
+    if (!ok) {
+        return false;
+    }
+
+    poses.swap(file_poses);
+    step = file_step;
+    return true;
+}
+
+bool CameraPath::generate(const std::string &name, int steps, double step) {
+    std::vector<CameraPose> generated(steps);
+    for (int i=0; i<steps; i++) {
+        float progress = i / (float)steps;
+        float wave = sinf(2*PI*progress);
+        CameraPose &pose = generated[i];
+
+        if (name == "orbit") {
+            // once around, bobbing up and down
+            pose.roll = 30.0f + 360.0f*progress;
+            pose.pitch = 70.0f - 15.0f*wave;
+        } else if (name == "flyover") {
+            // low and close, sliding from one edge to the other
+            pose.roll = 30.0f + 20.0f*progress;
+            pose.pitch = 65.0f;
+            pose.position = Eigen::Vector3f(0.3f*wave, -1.5f + 3.0f*progress, 0);
+            pose.zoom = 2.0f;
+        } else if (name == "zoom") {
+            // in to 4x and back out
+            pose.zoom = 1.0f + 1.5f*(1 - cosf(2*PI*progress));
+        } else {
+            return false;
+        }
+    }
+
+    poses.swap(generated);
+    this->step = step;
+    return true;
+}
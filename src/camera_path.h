@@ -0,0 +1,49 @@
+#ifndef CAMERA_PATH_H
+#define CAMERA_PATH_H
+
+#include <Eigen/Core>
+#include <string>
+#include <vector>
+
+// where the camera is at one simulation step
+struct CameraPose {
+    // degrees
+    float roll = 30.0f;
+    float pitch = 70.0f;
+    Eigen::Vector3f position = Eigen::Vector3f::Zero();
+    // screen space magnification
+    float zoom = 1.0f;
+};
+
+// the camera pose at every fixed simulation step of a run. paths are recorded
+// from live input or generated, then replayed one step per frame so two runs
+// render exactly the same frames
+class CameraPath {
+    private:
+        std::vector<CameraPose> poses;
+        // seconds per step
+        double step = 1.0/60;
+
+    public:
+        CameraPath() {}
+        CameraPath(double step): step(step) {}
+
+        void add(const CameraPose &pose) { poses.push_back(pose); }
+        void clear() { poses.clear(); }
+
+        int get_length() { return poses.size(); }
+        const CameraPose &get(int index) { return poses[index]; }
+        double get_step() { return step; }
+
+        // a text file with the step on the first line and a pose per line
+        // after it. false if the file can't be written, read or parsed
+        bool save(const std::string &path);
+        bool load(const std::string &path);
+
+        // a built-in path of `steps` steps: "orbit" circles the terrain,
+        // "flyover" sweeps across it close up and "zoom" pushes in and back
+        // out. false if the name isn't one of them
+        bool generate(const std::string &name, int steps, double step);
+};
+
+#endif // CAMERA_PATH_H
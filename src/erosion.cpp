@@ -0,0 +1,306 @@
+#include "erosion.h"
+#include "fast_math.h"
+#include "profiler.h"
+#include <algorithm>
+#include <math.h>
+
+// keeps the divisions finite where no water or material moves
+#define EROSION_EPSILON 1e-20f
+
+// the kernels below take a run of n points of one row and pointers to the
+// same run shifted to the left, right, lower and upper neighbours. on the
+// borders the shifted pointers point at the run itself, so nothing flows
+// out of the grid, and the incoming fractions at zeros, so nothing flows
+// in
+
+// the fraction of every point's water flowing to each lower neighbour
+static void flow_run(int n, float flow,
+        const float *__restrict h, const float *__restrict hl, const float *__restrict hr,
+        const float *__restrict hd, const float *__restrict hu,
+        const float *__restrict w, const float *__restrict wl, const float *__restrict wr,
+        const float *__restrict wd, const float *__restrict wu,
+        float *__restrict out_l, float *__restrict out_r, float *__restrict out_d, float *__restrict out_u) {
+    for (int i=0; i<n; i++) {
+        float surface = h[i] + w[i];
+        float dl = std::max(surface - hl[i] - wl[i], 0.0f);
+        float dr = std::max(surface - hr[i] - wr[i], 0.0f);
+        float dd = std::max(surface - hd[i] - wd[i], 0.0f);
+        float du = std::max(surface - hu[i] - wu[i], 0.0f);
+        // no more than the water there is leaves
+        float total = flow*(dl + dr + dd + du);
+        float scale = flow / std::max(std::max(total, w[i]), EROSION_EPSILON);
+        out_l[i] = dl*scale;
+        out_r[i] = dr*scale;
+        out_d[i] = dd*scale;
+        out_u[i] = du*scale;
+    }
+}
+
+// move the water and its sediment by the fractions, then dissolve or deposit
+// towards the capacity of the water that left, rain and evaporate
+static void transport_run(int n, const ErosionParameters &p, float inverse_spacing,
+        const float *__restrict h, const float *__restrict hl, const float *__restrict hr,
+        const float *__restrict hd, const float *__restrict hu,
+        const float *__restrict w, const float *__restrict wl, const float *__restrict wr,
+        const float *__restrict wd, const float *__restrict wu,
+        const float *__restrict s, const float *__restrict sl, const float *__restrict sr,
+        const float *__restrict sd, const float *__restrict su,
+        const float *__restrict out_l, const float *__restrict out_r,
+        const float *__restrict out_d, const float *__restrict out_u,
+        const float *__restrict from_l, const float *__restrict from_r,
+        const float *__restrict from_d, const float *__restrict from_u,
+        float *__restrict h_next, float *__restrict w_next, float *__restrict s_next) {
+    float half = 0.5f*inverse_spacing;
+    for (int i=0; i<n; i++) {
+        float leaving = out_l[i] + out_r[i] + out_d[i] + out_u[i];
+        float water = w[i]*(1 - leaving) + wl[i]*from_l[i] + wr[i]*from_r[i] + wd[i]*from_d[i] + wu[i]*from_u[i];
+        float sediment = s[i]*(1 - leaving) + sl[i]*from_l[i] + sr[i]*from_r[i] + sd[i]*from_d[i] + su[i]*from_u[i];
+
+        float gx = (hr[i] - hl[i])*half, gy = (hu[i] - hd[i])*half;
+        float slope = sqrt_fast(gx*gx + gy*gy);
+        float capacity = p.capacity*slope*w[i]*leaving;
+        // never dig below the lowest neighbour, deeper pits would only
+        // steepen and dig faster
+        float lowest = std::min(std::min(hl[i], hr[i]), std::min(hd[i], hu[i]));
+        float dig = std::min(p.dissolving*std::max(capacity - sediment, 0.0f), std::max(h[i] - lowest, 0.0f));
+        float change = dig - p.deposition*std::max(sediment - capacity, 0.0f);
+
+        h_next[i] = h[i] - change;
+        s_next[i] = sediment + change;
+        w_next[i] = water*(1 - p.evaporation) + p.rain;
+    }
+}
+
+// the material sliding from every point to each neighbour lower than the
+// talus allows, a share of the steepest excess split by excess
+static void slide_run(int n, float talus, float rate,
+        const float *__restrict h, const float *__restrict hl, const float *__restrict hr,
+        const float *__restrict hd, const float *__restrict hu,
+        float *__restrict out_l, float *__restrict out_r, float *__restrict out_d, float *__restrict out_u) {
+    for (int i=0; i<n; i++) {
+        float el = std::max(h[i] - hl[i] - talus, 0.0f);
+        float er = std::max(h[i] - hr[i] - talus, 0.0f);
+        float ed = std::max(h[i] - hd[i] - talus, 0.0f);
+        float eu = std::max(h[i] - hu[i] - talus, 0.0f);
+        float steepest = std::max(std::max(el, er), std::max(ed, eu));
+        // half the excess levels a pair of points
+        float scale = 0.5f*rate*steepest / std::max(el + er + ed + eu, EROSION_EPSILON);
+        out_l[i] = el*scale;
+        out_r[i] = er*scale;
+        out_d[i] = ed*scale;
+        out_u[i] = eu*scale;
+    }
+}
+
+// the height after the material slid in and out
+static void settle_run(int n, const float *__restrict h,
+        const float *__restrict out_l, const float *__restrict out_r,
+        const float *__restrict out_d, const float *__restrict out_u,
+        const float *__restrict from_l, const float *__restrict from_r,
+        const float *__restrict from_d, const float *__restrict from_u,
+        float *__restrict h_next) {
+    for (int i=0; i<n; i++) {
+        h_next[i] = h[i] + from_l[i] + from_r[i] + from_d[i] + from_u[i]
+            - out_l[i] - out_r[i] - out_d[i] - out_u[i];
+    }
+}
+
+// a row split into the left border, the inside and the right border: the
+// first column, its length and the offsets to the left and right neighbours
+struct ErosionRun {
+    int first, count, left, right;
+};
+
+static int row_runs(int columns, ErosionRun runs[3]) {
+    int count = 0;
+    runs[count++] = ErosionRun{ 0, 1, 0, 1 };
+    if (columns > 2) {
+        runs[count++] = ErosionRun{ 1, columns - 2, -1, 1 };
+    }
+    runs[count++] = ErosionRun{ columns - 1, 1, -1, 0 };
+    return count;
+}
+
+// the rows of a field, either all of them or a ring of the last three
+struct FieldRows {
+    float *data;
+    int columns;
+    bool ring;
+
+    float *row(int j) const { return data + (size_t)(ring ? j % 3 : j)*columns; }
+};
+
+// pointers to a run of row j and the same run in its four neighbours
+struct Neighbours {
+    const float *c, *l, *r, *d, *u;
+
+    Neighbours(const FieldRows &field, int rows, int j, const ErosionRun &run) {
+        c = field.row(j) + run.first;
+        l = c + run.left;
+        r = c + run.right;
+        d = j > 0 ? field.row(j - 1) + run.first : c;
+        u = j < rows - 1 ? field.row(j + 1) + run.first : c;
+    }
+};
+
+// pointers to what flows into a run of row j from each side, given what
+// flows out of every point to the left, right, down and up, zeros where the
+// neighbour is off the grid
+struct Incoming {
+    const float *l, *r, *d, *u;
+
+    Incoming(const FieldRows out[4], const float *zeros, int rows, int j, const ErosionRun &run) {
+        // the left neighbour's flow to the right comes in from the left
+        l = run.left ? out[1].row(j) + run.first - 1 : zeros;
+        r = run.right ? out[0].row(j) + run.first + 1 : zeros;
+        d = j > 0 ? out[3].row(j - 1) + run.first : zeros;
+        u = j < rows - 1 ? out[2].row(j + 1) + run.first : zeros;
+    }
+};
+
+// rings of the last three rows of every pass: the water's outflow
+// fractions, the heights, water and sediment after the transport, and the
+// material sliding out
+struct Erosion::BandRows {
+    std::vector<float> data;
+    FieldRows flow[4], h, w, s, slide[4];
+
+    void resize(int columns) {
+        size_t ring = 3*(size_t)columns;
+        data.resize(11*ring);
+        FieldRows *fields[11] = { &flow[0], &flow[1], &flow[2], &flow[3], &h, &w, &s,
+            &slide[0], &slide[1], &slide[2], &slide[3] };
+        for (int f=0; f<11; f++) {
+            *fields[f] = FieldRows{ &data[f*ring], columns, true };
+        }
+    }
+};
+
+void Erosion::resize(int columns, int rows) {
+    this->columns = columns;
+    this->rows = rows;
+    size_t count = (size_t)columns*rows;
+    for (int b=0; b<2; b++) {
+        heights[b].resize(count);
+        water[b].resize(count);
+        sediment[b].resize(count);
+    }
+    zeros.assign(columns, 0.0f);
+}
+
+void Erosion::erode_band(const ErosionParameters &p, float spacing, int begin, int end, BandRows &band) {
+    ErosionRun runs[3];
+    int run_count = row_runs(columns, runs);
+    int next = 1 - current;
+    FieldRows h = { &heights[current][0], columns, false };
+    FieldRows w = { &water[current][0], columns, false };
+    FieldRows s = { &sediment[current][0], columns, false };
+    FieldRows h_next = { &heights[next][0], columns, false };
+    FieldRows w_next = { &water[next][0], columns, false };
+    FieldRows s_next = { &sediment[next][0], columns, false };
+    bool thermal = p.thermal_rate > 0;
+    // without the thermal passes the transport writes the next fields
+    // directly, with them it feeds the band's rings
+    const FieldRows &h_moved = thermal ? band.h : h_next;
+    const FieldRows &w_moved = thermal ? band.w : w_next;
+    const FieldRows &s_moved = thermal ? band.s : s_next;
+
+    // every pass needs the rows around it from the pass before, so the
+    // passes trail each other by a row and start that many rows early:
+    // row t flows, t - 1 is transported, t - 2 slides and t - 3 settles
+    int halo = thermal ? 3 : 1;
+    for (int t=begin - halo; t<end + halo; t++) {
+        int j = t;
+        if (j >= 0 && j < rows) {
+            for (int k=0; k<run_count; k++) {
+                const ErosionRun &run = runs[k];
+                Neighbours nh(h, rows, j, run), nw(w, rows, j, run);
+                flow_run(run.count, p.flow, nh.c, nh.l, nh.r, nh.d, nh.u, nw.c, nw.l, nw.r, nw.d, nw.u,
+                        band.flow[0].row(j) + run.first, band.flow[1].row(j) + run.first,
+                        band.flow[2].row(j) + run.first, band.flow[3].row(j) + run.first);
+            }
+        }
+
+        j = t - 1;
+        if (j >= begin - (halo - 1) && j >= 0 && j < rows) {
+            for (int k=0; k<run_count; k++) {
+                const ErosionRun &run = runs[k];
+                Neighbours nh(h, rows, j, run), nw(w, rows, j, run), ns(s, rows, j, run);
+                Incoming from(band.flow, &zeros[0], rows, j, run);
+                // one sided differences on the borders, over twice the spacing
+                transport_run(run.count, p, 1 / spacing, nh.c, nh.l, nh.r, nh.d, nh.u,
+                        nw.c, nw.l, nw.r, nw.d, nw.u, ns.c, ns.l, ns.r, ns.d, ns.u,
+                        band.flow[0].row(j) + run.first, band.flow[1].row(j) + run.first,
+                        band.flow[2].row(j) + run.first, band.flow[3].row(j) + run.first,
+                        from.l, from.r, from.d, from.u,
+                        h_moved.row(j) + run.first, w_moved.row(j) + run.first, s_moved.row(j) + run.first);
+            }
+        }
+        if (!thermal) {
+            continue;
+        }
+
+        j = t - 2;
+        if (j >= begin - 1 && j >= 0 && j < rows) {
+            for (int k=0; k<run_count; k++) {
+                const ErosionRun &run = runs[k];
+                Neighbours nh(band.h, rows, j, run);
+                slide_run(run.count, p.talus*spacing, p.thermal_rate, nh.c, nh.l, nh.r, nh.d, nh.u,
+                        band.slide[0].row(j) + run.first, band.slide[1].row(j) + run.first,
+                        band.slide[2].row(j) + run.first, band.slide[3].row(j) + run.first);
+            }
+        }
+
+        j = t - 3;
+        if (j >= begin && j >= 0 && j < rows) {
+            for (int k=0; k<run_count; k++) {
+                const ErosionRun &run = runs[k];
+                Incoming from(band.slide, &zeros[0], rows, j, run);
+                settle_run(run.count, band.h.row(j) + run.first,
+                        band.slide[0].row(j) + run.first, band.slide[1].row(j) + run.first,
+                        band.slide[2].row(j) + run.first, band.slide[3].row(j) + run.first,
+                        from.l, from.r, from.d, from.u, h_next.row(j) + run.first);
+            }
+            std::copy(band.w.row(j), band.w.row(j) + columns, w_next.row(j));
+            std::copy(band.s.row(j), band.s.row(j) + columns, s_next.row(j));
+        }
+    }
+}
+
+void Erosion::erode(Heightfield &terrain, const ErosionParameters &parameters, ThreadPool *pool) {
+    PROFILE_ZONE("erosion");
+    if (terrain.columns < 2 || terrain.rows < 2) {
+        return;
+    }
+    resize(terrain.columns, terrain.rows);
+    current = 0;
+    heights[0] = terrain.heights;
+    std::fill(water[0].begin(), water[0].end(), parameters.rain);
+    std::fill(sediment[0].begin(), sediment[0].end(), 0.0f);
+
+    float spacing = terrain.spacing;
+    int bands = (rows + EROSION_BAND_ROWS - 1) / EROSION_BAND_ROWS;
+    auto erode_bands = [&](int first, int last) {
+        // per thread so bands can run in parallel without allocating
+        static thread_local BandRows band;
+        band.resize(columns);
+        for (int b=first; b<last; b++) {
+            erode_band(parameters, spacing, b*EROSION_BAND_ROWS,
+                    std::min((b + 1)*EROSION_BAND_ROWS, rows), band);
+        }
+    };
+    for (int iteration=0; iteration<parameters.iterations; iteration++) {
+        if (pool) {
+            pool->parallel_for(bands, 1, erode_bands);
+        } else {
+            erode_bands(0, bands);
+        }
+        current = 1 - current;
+    }
+
+    // the water dries up and drops what it still carries
+    for (size_t i=0; i<terrain.heights.size(); i++) {
+        terrain.heights[i] = heights[current][i] + sediment[current][i];
+    }
+    terrain.compute_normals();
+}
@@ -0,0 +1,65 @@
+#ifndef EROSION_H
+#define EROSION_H
+
+#include "heightfield.h"
+#include "thread_pool.h"
+#include <vector>
+
+// rows of the grid a thread erodes at a time. the passes of an iteration are
+// fused over a band so its rows stay in cache, at the cost of redoing a few
+// rows around every band
+#define EROSION_BAND_ROWS 32
+
+struct ErosionParameters {
+    int iterations = 200;
+    // water rained on every point each iteration, in height units
+    float rain = 0.002f;
+    // fraction of the water that evaporates each iteration
+    float evaporation = 0.03f;
+    // fraction of the water surface height difference to a lower
+    // neighbour that flows to it each iteration, above 0.125 the water sloshes
+    // back and forth between neighbours
+    float flow = 0.1f;
+    // sediment a unit of flowing water can carry per unit of slope
+    float capacity = 20.0f;
+    // fractions of the capacity shortfall picked up, and of the excess
+    // dropped, each iteration
+    float dissolving = 0.2f;
+    float deposition = 0.1f;
+    // height difference per unit distance above which material slides to
+    // lower neighbours, and the fraction of the excess that slides each
+    // iteration. 0 turns thermal erosion off
+    float talus = 0.8f;
+    float thermal_rate = 0.5f;
+};
+
+// erodes a heightfield on a grid: rain collects and flows downhill, picking
+// up sediment where it runs fast and steep and dropping it where it slows,
+// and slopes steeper than the talus crumble onto their neighbours. every
+// iteration reads one copy of the fields and writes the other, so rows can
+// be split over threads and the result doesn't depend on how many there are
+class Erosion {
+    private:
+        int columns = 0, rows = 0;
+        // two copies of each field, an iteration reads from current
+        std::vector<float> heights[2], water[2], sediment[2];
+        int current = 0;
+        // a row of nothing flowing in from off the grid
+        std::vector<float> zeros;
+
+        // the last rows of every pass of a band, defined with the passes
+        struct BandRows;
+
+        void resize(int columns, int rows);
+        // one iteration over rows [begin, end)
+        void erode_band(const ErosionParameters &p, float spacing, int begin, int end, BandRows &band);
+
+    public:
+        Erosion() {}
+
+        // run the iterations over the terrain's heights and rebuild its
+        // normals, with the bands split over the pool when given one
+        void erode(Heightfield &terrain, const ErosionParameters &parameters, ThreadPool *pool = NULL);
+};
+
+#endif // EROSION_H
@@ -0,0 +1,55 @@
+#ifndef FAST_MATH_H
+#define FAST_MATH_H
+
+#include <stdint.h>
+#include <string.h>
+
+// helpers for the vectorized kernels. those are small static functions over
+// __restrict array arguments, since in a member function gcc has to assume
+// every store may alias the members or the other arrays and won't vectorize
+
+// sin and cos of x without branches or calls, so loops using it vectorize.
+// x is reduced to [-pi/4, pi/4] around the nearest quarter turn and the
+// polynomials are accurate to about 3e-7 there. the reduction keeps that for
+// |x| up to a few thousand
+inline void sincos_fast(float x, float &s, float &c) {
+    float turns = x * 0.636619772f + 0.5f;
+    // floor without a call, truncation rounds negative values up
+    int quadrant = (int)turns;
+    quadrant -= turns < (float)quadrant;
+    // pi/2 split in two so the reduction keeps its precision
+    float r = (x - quadrant * 1.5703125f) - quadrant * 4.83826794897e-4f;
+    float r2 = r*r;
+    float sin_r = r*(1 + r2*(-1.0f/6 + r2*(1.0f/120 + r2*(-1.0f/5040))));
+    float cos_r = 1 + r2*(-0.5f + r2*(1.0f/24 + r2*(-1.0f/720 + r2*(1.0f/40320))));
+
+    // rotate by the quadrant, the low two bits are the quadrant modulo 4
+    // for negative ones too
+    float s0 = quadrant & 1 ? cos_r : sin_r;
+    float c0 = quadrant & 1 ? sin_r : cos_r;
+    s = quadrant & 2 ? -s0 : s0;
+    c = (quadrant + 1) & 2 ? -c0 : c0;
+}
+
+// square root of x >= 0 without the errno check of sqrtf, whose branch keeps
+// loops from vectorizing. x times two Newton steps of the reciprocal square
+// root from the bit trick guess, accurate to about 5e-6
+inline float sqrt_fast(float x) {
+    int32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    bits = 0x5f375a86 - (bits >> 1);
+    float y;
+    memcpy(&y, &bits, sizeof(y));
+    y = y*(1.5f - 0.5f*x*y*y);
+    y = y*(1.5f - 0.5f*x*y*y);
+    return x*y;
+}
+
+// the largest integer not above x, floorf is a call the vectorizer can't use
+// without SSE4.1
+inline int floor_fast(float x) {
+    int i = (int)x;
+    return i - (x < i);
+}
+
+#endif // FAST_MATH_H
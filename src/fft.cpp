@@ -0,0 +1,177 @@
+#include "fft.h"
+#include <math.h>
+#include <string.h>
+
+FFT2D::FFT2D(int size): size(size), twiddle_re(size), twiddle_im(size) {
+    for (int k=0; k<size; k++) {
+        double angle = -2*M_PI*k / size;
+        twiddle_re[k] = cos(angle);
+        twiddle_im[k] = sin(angle);
+    }
+}
+
+// the butterflies of one twiddle, over span consecutive lanes. the inputs and
+// outputs are passed separately so the compiler knows they don't overlap and
+// vectorizes the loop
+static void butterfly4(size_t span, const float *w,
+        const float *__restrict ar, const float *__restrict ai, const float *__restrict br, const float *__restrict bi,
+        const float *__restrict cr, const float *__restrict ci, const float *__restrict dr, const float *__restrict di,
+        float *__restrict y0r, float *__restrict y0i, float *__restrict y1r, float *__restrict y1i,
+        float *__restrict y2r, float *__restrict y2i, float *__restrict y3r, float *__restrict y3i) {
+    float w1r = w[0], w1i = w[1], w2r = w[2], w2i = w[3], w3r = w[4], w3i = w[5];
+    for (size_t q=0; q<span; q++) {
+        float apc_r = ar[q] + cr[q], apc_i = ai[q] + ci[q];
+        float amc_r = ar[q] - cr[q], amc_i = ai[q] - ci[q];
+        float bpd_r = br[q] + dr[q], bpd_i = bi[q] + di[q];
+        float bmd_r = br[q] - dr[q], bmd_i = bi[q] - di[q];
+
+        // (a - c) -/+ i(b - d)
+        float t1r = amc_r + bmd_i, t1i = amc_i - bmd_r;
+        float t3r = amc_r - bmd_i, t3i = amc_i + bmd_r;
+        float t2r = apc_r - bpd_r, t2i = apc_i - bpd_i;
+
+        y0r[q] = apc_r + bpd_r;
+        y0i[q] = apc_i + bpd_i;
+        y1r[q] = w1r*t1r - w1i*t1i;
+        y1i[q] = w1r*t1i + w1i*t1r;
+        y2r[q] = w2r*t2r - w2i*t2i;
+        y2i[q] = w2r*t2i + w2i*t2r;
+        y3r[q] = w3r*t3r - w3i*t3i;
+        y3i[q] = w3r*t3i + w3i*t3r;
+    }
+}
+
+// one radix-4 Stockham stage over sub-transforms of length `length`, each
+// element being FFT_LANES lanes wide. stride is size / length
+static void radix4(int length, int stride, const float *tw_re, const float *tw_im,
+        const float *xr, const float *xi, float *yr, float *yi) {
+    int quarter = length / 4;
+    size_t span = (size_t)stride * FFT_LANES;
+    size_t b = quarter*span, c = 2*b, d = 3*b;
+    for (int p=0; p<quarter; p++) {
+        const float w[6] = {
+            tw_re[p*stride], tw_im[p*stride],
+            tw_re[2*p*stride], tw_im[2*p*stride],
+            tw_re[3*p*stride], tw_im[3*p*stride]
+        };
+        // the four inputs are a quarter of the transform apart, the four
+        // outputs next to each other
+        const float *a = xr + p*span, *ai = xi + p*span;
+        float *y = yr + 4*p*span, *yi_ = yi + 4*p*span;
+        butterfly4(span, w, a, ai, a + b, ai + b, a + c, ai + c, a + d, ai + d,
+                y, yi_, y + span, yi_ + span, y + 2*span, yi_ + 2*span, y + 3*span, yi_ + 3*span);
+    }
+}
+
+// the last stage of odd powers of two, two elements and no twiddles
+static void radix2(int stride, const float *__restrict xr, const float *__restrict xi,
+        float *__restrict yr, float *__restrict yi) {
+    int span = stride * FFT_LANES;
+    for (int q=0; q<span; q++) {
+        yr[q] = xr[q] + xr[q + span];
+        yi[q] = xi[q] + xi[q + span];
+        yr[q + span] = xr[q] - xr[q + span];
+        yi[q + span] = xi[q] - xi[q + span];
+    }
+}
+
+void FFT2D::transform_block(float *re, float *im, int first, bool rows, bool inverse) {
+    // two ping-pong buffers of size x FFT_LANES complex values, per thread so
+    // blocks can run in parallel without allocating
+    static thread_local std::vector<float> scratch;
+    size_t plane = (size_t)size * FFT_LANES;
+    if (scratch.size() < 4*plane) {
+        scratch.resize(4*plane);
+    }
+    float *xr = &scratch[0], *xi = xr + plane, *yr = xi + plane, *yi = yr + plane;
+
+    // the inverse is the conjugate of the forward transform of the conjugate
+    float sign = inverse ? -1.0f : 1.0f;
+
+    // element k of lane l sits at k*FFT_LANES + l
+    if (rows) {
+        for (int l=0; l<FFT_LANES; l++) {
+            const float *row_re = re + (size_t)(first + l)*size;
+            const float *row_im = im + (size_t)(first + l)*size;
+            for (int k=0; k<size; k++) {
+                xr[k*FFT_LANES + l] = row_re[k];
+                xi[k*FFT_LANES + l] = sign*row_im[k];
+            }
+        }
+    } else {
+        for (int k=0; k<size; k++) {
+            memcpy(xr + k*FFT_LANES, re + (size_t)k*size + first, FFT_LANES*sizeof(float));
+            for (int l=0; l<FFT_LANES; l++) {
+                xi[k*FFT_LANES + l] = sign*im[(size_t)k*size + first + l];
+            }
+        }
+    }
+
+    int length = size, stride = 1;
+    for (; length >= 4; length /= 4, stride *= 4) {
+        radix4(length, stride, &twiddle_re[0], &twiddle_im[0], xr, xi, yr, yi);
+        std::swap(xr, yr);
+        std::swap(xi, yi);
+    }
+    if (length == 2) {
+        radix2(stride, xr, xi, yr, yi);
+        std::swap(xr, yr);
+        std::swap(xi, yi);
+    }
+
+    if (rows) {
+        for (int l=0; l<FFT_LANES; l++) {
+            float *row_re = re + (size_t)(first + l)*size;
+            float *row_im = im + (size_t)(first + l)*size;
+            for (int k=0; k<size; k++) {
+                row_re[k] = xr[k*FFT_LANES + l];
+                row_im[k] = sign*xi[k*FFT_LANES + l];
+            }
+        }
+    } else {
+        for (int k=0; k<size; k++) {
+            memcpy(re + (size_t)k*size + first, xr + k*FFT_LANES, FFT_LANES*sizeof(float));
+            for (int l=0; l<FFT_LANES; l++) {
+                im[(size_t)k*size + first + l] = sign*xi[k*FFT_LANES + l];
+            }
+        }
+    }
+}
+
+void FFT2D::forward(float *re, float *im, ThreadPool *pool) {
+    int blocks = size / FFT_LANES;
+    for (int pass=0; pass<2; pass++) {
+        std::function<void(int, int)> body = [&](int begin, int end) {
+            for (int b=begin; b<end; b++) {
+                transform_block(re, im, b*FFT_LANES, pass == 0, false);
+            }
+        };
+        if (pool) {
+            pool->parallel_for(blocks, 1, body);
+        } else {
+            body(0, blocks);
+        }
+    }
+}
+
+void FFT2D::inverse(float *re, float *im, ThreadPool *pool) {
+    inverse(1, &re, &im, pool);
+}
+
+void FFT2D::inverse(int count, float **re, float **im, ThreadPool *pool) {
+    int blocks = size / FFT_LANES;
+    // every row of every plane, then every column
+    for (int pass=0; pass<2; pass++) {
+        std::function<void(int, int)> body = [&](int begin, int end) {
+            for (int b=begin; b<end; b++) {
+                int plane = b / blocks;
+                transform_block(re[plane], im[plane], (b % blocks)*FFT_LANES, pass == 0, true);
+            }
+        };
+        if (pool) {
+            pool->parallel_for(count*blocks, 1, body);
+        } else {
+            body(0, count*blocks);
+        }
+    }
+}
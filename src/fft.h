@@ -0,0 +1,39 @@
+#ifndef FFT_H
+#define FFT_H
+
+#include "thread_pool.h"
+#include <vector>
+
+// columns or rows transformed together, one per SIMD lane
+#define FFT_LANES 8
+
+// square 2D complex FFT of a power of two size, with the real and imaginary
+// parts in separate planes stored row after row. each pass copies FFT_LANES
+// rows or columns into a small interleaved block that stays in cache, runs
+// radix-4 Stockham stages (radix-2 for the last one when the size is an odd
+// power of two) over all lanes at once and copies them back. blocks are
+// independent, so they are spread over a thread pool when given one
+class FFT2D {
+    private:
+        int size = 0;
+        // exp(-2 pi i k / size)
+        std::vector<float> twiddle_re, twiddle_im;
+
+        void transform_block(float *re, float *im, int first, bool rows, bool inverse);
+
+    public:
+        FFT2D() {}
+        // size must be a power of two of at least FFT_LANES
+        FFT2D(int size);
+
+        int get_size() { return size; }
+
+        // in place and unnormalized, inverse(forward(x)) is size*size*x
+        void forward(float *re, float *im, ThreadPool *pool = NULL);
+        void inverse(float *re, float *im, ThreadPool *pool = NULL);
+        // the inverse transform of several planes in one go, which keeps the
+        // pool busy with fewer wake-ups
+        void inverse(int count, float **re, float **im, ThreadPool *pool = NULL);
+};
+
+#endif // FFT_H
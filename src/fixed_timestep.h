@@ -0,0 +1,40 @@
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+// turns variable frame times into a number of fixed simulation steps. the
+// time left over is kept for the next frame and exposed as the fraction of
+// a step rendering should interpolate by
+class FixedTimestep {
+    private:
+        double step = 1.0/60;
+        int max_steps = 5;
+        double accumulator = 0;
+
+    public:
+        FixedTimestep() {}
+        // rate in steps per second, at most max_steps are run per frame
+        FixedTimestep(double rate, int max_steps): step(1.0/rate), max_steps(max_steps) {}
+
+        // add a frame's time, returns how many steps to simulate for it. when
+        // the frame took longer than max_steps the excess time is dropped, so
+        // a slow frame slows the simulation down instead of snowballing
+        int advance(double delta) {
+            accumulator += delta;
+            int steps = 0;
+            while (accumulator >= step && steps < max_steps) {
+                accumulator -= step;
+                steps++;
+            }
+            if (steps == max_steps && accumulator >= step) {
+                accumulator = 0;
+            }
+            return steps;
+        }
+
+        // seconds per step
+        double get_step() { return step; }
+        // how far into the next step the rendered frame is, in [0, 1)
+        double get_alpha() { return accumulator / step; }
+};
+
+#endif // FIXED_TIMESTEP_H
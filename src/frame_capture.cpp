@@ -0,0 +1,264 @@
+#include "frame_capture.h"
+#include "gl_state.h"
+#include "image_io.h"
+#include "logger.h"
+#include "profiler.h"
+#include <chrono>
+#include <string.h>
+
+// how long finishing waits for a readback before giving up on it
+#define CAPTURE_WAIT_NS 1000000000ULL
+
+static double seconds_since(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+FrameCapture::~FrameCapture() {
+    // the GL objects go with the context, only the thread needs stopping
+    if (writer.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        wake.notify_all();
+        writer.join();
+    }
+}
+
+bool FrameCapture::start(const std::string &pattern, int frame_limit) {
+    // exactly one conversion, an integer for the frame number
+    size_t percent = pattern.find('%');
+    size_t conversion = percent == std::string::npos ? percent : pattern.find_first_not_of("0123456789", percent + 1);
+    if (conversion == std::string::npos || pattern[conversion] != 'd'
+            || pattern.find('%', percent + 1) != std::string::npos) {
+        log("capture pattern %s needs one frame number like %%05d\n", pattern.c_str());
+        return false;
+    }
+
+    size_t dot = pattern.rfind('.');
+    std::string extension = dot == std::string::npos ? "" : pattern.substr(dot + 1);
+    if (extension == "png") {
+        format = CAPTURE_PNG;
+    } else if (extension == "ppm") {
+        format = CAPTURE_PPM;
+    } else if (extension == "raw" || extension == "rgb") {
+        format = CAPTURE_RAW;
+    } else {
+        log("capture pattern %s should end in .png, .ppm or .raw\n", pattern.c_str());
+        return false;
+    }
+
+    this->pattern = pattern;
+    this->frame_limit = frame_limit;
+    next_index = 0;
+
+    for (int i=0; i<CAPTURE_RING_SIZE; i++) {
+        glGenBuffers(1, &slots[i].buffer);
+    }
+    frames.resize(CAPTURE_QUEUE_SIZE);
+    for (int i=0; i<CAPTURE_QUEUE_SIZE; i++) {
+        free_frames.push_back(&frames[i]);
+    }
+    stopping = false;
+    writer = std::thread(&FrameCapture::writer_loop, this);
+
+    if (!glext.sync) {
+        log("capture: no fences, readbacks may stall when mapped\n");
+    }
+    active = true;
+    return true;
+}
+
+void FrameCapture::capture(int width, int height) {
+    if (!active) {
+        return;
+    }
+    PROFILE_ZONE("capture");
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // the slot about to be reused holds the oldest readback, done by now
+    Slot &slot = slots[next_slot];
+    if (slot.pending) {
+        retire(slot);
+    }
+    if (frame_limit > 0 && next_index >= frame_limit) {
+        return;
+    }
+
+    // read RGBA, the layout drivers copy fastest, and convert on the writer
+    GLsizeiptr size = (GLsizeiptr)width * height * 4;
+    gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    if (slot.size != size) {
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+        slot.size = size;
+    }
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+    gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.fence = glext.sync ? glext.FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) : NULL;
+    slot.pending = true;
+    slot.index = next_index++;
+    slot.width = width;
+    slot.height = height;
+    next_slot = (next_slot + 1) % CAPTURE_RING_SIZE;
+
+    capture_times.add(seconds_since(start));
+}
+
+void FrameCapture::retire(Slot &slot) {
+    slot.pending = false;
+    if (slot.fence) {
+        GLenum status = glext.ClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, CAPTURE_WAIT_NS);
+        glext.DeleteSync(slot.fence);
+        slot.fence = NULL;
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) {
+            log("capture: frame %d never finished reading back\n", slot.index);
+            std::lock_guard<std::mutex> lock(mutex);
+            failed++;
+            return;
+        }
+    }
+
+    Frame *frame = NULL;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (free_frames.empty()) {
+            // the writer is behind, skip the map and copy altogether
+            dropped++;
+            return;
+        }
+        frame = free_frames.back();
+        free_frames.pop_back();
+    }
+
+    frame->index = slot.index;
+    frame->width = slot.width;
+    frame->height = slot.height;
+    frame->pixels.resize(slot.size);
+
+    gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, slot.buffer);
+    const void *pixels = glMapBuffer(GL_PIXEL_PACK_BUFFER, GL_READ_ONLY);
+    bool ok = pixels != NULL;
+    if (ok) {
+        memcpy(&frame->pixels[0], pixels, slot.size);
+        ok = glUnmapBuffer(GL_PIXEL_PACK_BUFFER) == GL_TRUE;
+    }
+    gl_state.bind_buffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (ok) {
+            queue.push_back(frame);
+        } else {
+            free_frames.push_back(frame);
+            failed++;
+        }
+    }
+    wake.notify_one();
+}
+
+void FrameCapture::writer_loop() {
+    profiler.set_thread_name("capture");
+    std::vector<uint8_t> rgb;
+    while (true) {
+        Frame *frame;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return;
+            }
+            frame = queue.front();
+            queue.pop_front();
+        }
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        bool ok = write_frame(*frame, rgb);
+        double seconds = seconds_since(start);
+
+        std::lock_guard<std::mutex> lock(mutex);
+        encode_times.add(seconds);
+        if (ok) {
+            written++;
+        } else {
+            failed++;
+        }
+        free_frames.push_back(frame);
+    }
+}
+
+bool FrameCapture::write_frame(const Frame &frame, std::vector<uint8_t> &rgb) {
+    PROFILE_ZONE("write_frame");
+
+    // GL rows start at the bottom, images at the top, and alpha is dropped
+    // since the clear color leaves it at 0
+    rgb.resize((size_t)frame.width * frame.height * 3);
+    for (int y=0; y<frame.height; y++) {
+        const uint8_t *src = &frame.pixels[(size_t)(frame.height - 1 - y) * frame.width * 4];
+        uint8_t *dst = &rgb[(size_t)y * frame.width * 3];
+        for (int x=0; x<frame.width; x++) {
+            dst[3*x] = src[4*x];
+            dst[3*x + 1] = src[4*x + 1];
+            dst[3*x + 2] = src[4*x + 2];
+        }
+    }
+
+    char path[1024];
+    snprintf(path, sizeof(path), pattern.c_str(), frame.index);
+    bool ok;
+    switch (format) {
+        case CAPTURE_PNG:
+            ok = write_png(path, frame.width, frame.height, 3, 8, &rgb[0]);
+            break;
+        case CAPTURE_PPM:
+            ok = write_ppm(path, frame.width, frame.height, &rgb[0]);
+            break;
+        default:
+            ok = write_raw_bytes(path, &rgb[0], rgb.size());
+            break;
+    }
+    if (!ok) {
+        log("capture: could not write %s\n", path);
+    }
+    return ok;
+}
+
+void FrameCapture::finish() {
+    if (!active) {
+        return;
+    }
+    // oldest first, the slot after the last one written
+    for (int i=0; i<CAPTURE_RING_SIZE; i++) {
+        Slot &slot = slots[(next_slot + i) % CAPTURE_RING_SIZE];
+        if (slot.pending) {
+            retire(slot);
+        }
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    writer.join();
+
+    for (int i=0; i<CAPTURE_RING_SIZE; i++) {
+        gl_state.forget_buffer(slots[i].buffer);
+        glDeleteBuffers(1, &slots[i].buffer);
+        slots[i] = Slot();
+    }
+    active = false;
+}
+
+void FrameCapture::report(FILE *file) {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (next_index == 0) {
+        return;
+    }
+    StatsSummary capture = capture_times.summarize();
+    StatsSummary encode = encode_times.summarize();
+    fprintf(file, "capture: %d frames written, %d dropped, %d failed\n", written, dropped, failed);
+    fprintf(file, "capture ms on the render thread avg %.3f p99 %.3f max %.3f, writing avg %.3f p99 %.3f\n",
+            capture.avg*1e3, capture.p99*1e3, capture.max*1e3, encode.avg*1e3, encode.p99*1e3);
+}
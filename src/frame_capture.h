@@ -0,0 +1,96 @@
+#ifndef FRAME_CAPTURE_H
+#define FRAME_CAPTURE_H
+
+#include "gl_ext.h"
+#include "rolling_stats.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdint.h>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// frames a readback stays in flight before it is mapped, so the GPU has
+// finished the copy by the time the CPU looks at it
+#define CAPTURE_RING_SIZE 3
+// frames waiting for the writer thread before new ones are dropped
+#define CAPTURE_QUEUE_SIZE 8
+
+// file format of captured frames, picked from the file extension
+enum CaptureFormat {CAPTURE_RAW, CAPTURE_PPM, CAPTURE_PNG};
+
+// saves rendered frames as an image sequence without stalling the render
+// thread. each frame is copied into a pixel buffer object of a small ring
+// with a fence behind it, mapped CAPTURE_RING_SIZE - 1 frames later once the
+// fence has passed, and handed to a writer thread that flips, converts and
+// encodes it. if the writer falls behind frames are dropped, not waited for
+class FrameCapture {
+    private:
+        struct Slot {
+            GLuint buffer = 0;
+            GLsizeiptr size = 0;
+            // GLsync of the readback, NULL without ARB_sync
+            void *fence = NULL;
+            bool pending = false;
+            int index = 0, width = 0, height = 0;
+        };
+
+        // a mapped frame on its way to the writer, bottom row first RGBA
+        struct Frame {
+            int index = 0, width = 0, height = 0;
+            std::vector<uint8_t> pixels;
+        };
+
+        bool active = false;
+        std::string pattern;
+        CaptureFormat format = CAPTURE_PNG;
+        int frame_limit = 0;
+        int next_index = 0;
+
+        Slot slots[CAPTURE_RING_SIZE];
+        int next_slot = 0;
+
+        // the writer and the frames shared with it, guarded by mutex
+        std::thread writer;
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::deque<Frame *> queue;
+        std::vector<Frame *> free_frames;
+        std::vector<Frame> frames;
+        bool stopping = false;
+        int written = 0, failed = 0, dropped = 0;
+
+        // render thread cost of capture() and writer time per frame, seconds
+        RollingStats capture_times, encode_times;
+
+        // wait for a slot's readback and hand it to the writer
+        void retire(Slot &slot);
+        void writer_loop();
+        bool write_frame(const Frame &frame, std::vector<uint8_t> &rgb);
+
+    public:
+        FrameCapture() {}
+        ~FrameCapture();
+
+        FrameCapture(const FrameCapture &) = delete;
+        FrameCapture &operator=(const FrameCapture &) = delete;
+
+        // capture into files named by the printf pattern (e.g. frames/%05d.png)
+        // from the frame number, at most frames of them (0 for no limit).
+        // needs a current context, false if the pattern isn't usable
+        bool start(const std::string &pattern, int frames);
+        bool is_active() { return active; }
+
+        // queue a readback of the current read buffer, call after drawing
+        void capture(int width, int height);
+
+        // write out the frames still in flight and stop the writer, needs the
+        // context to still be current
+        void finish();
+
+        void report(FILE *file);
+};
+
+#endif // FRAME_CAPTURE_H
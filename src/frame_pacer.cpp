@@ -0,0 +1,103 @@
+#include "frame_pacer.h"
+#include "logger.h"
+#include <GLFW/glfw3.h>
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+// frames used to decide whether the swap interval actually blocks
+#define VSYNC_CHECK_FRAMES 30
+// never spin for longer than this, even after a bad oversleep
+#define MAX_SPIN_MARGIN 0.004
+
+double FramePacer::now() {
+    using namespace std::chrono;
+    return duration<double>(steady_clock::now().time_since_epoch()).count() - start_time;
+}
+
+void FramePacer::setup(double rate, bool allow_vsync, int refresh_rate) {
+    target_rate = rate;
+    start_time = 0;
+    start_time = now();
+    last_frame = next_deadline = 0;
+    intervals.clear();
+    lateness.clear();
+
+    // the display can only pace us at its own refresh rate
+    use_vsync = allow_vsync && rate > 0 && refresh_rate > 0 && fabs(refresh_rate - rate) < 1.0;
+    glfwSwapInterval(use_vsync ? 1 : 0);
+    vsync_checked_frames = 0;
+
+    log("frame pacing: %s\n", rate <= 0 ? "uncapped" : use_vsync ? "vsync" : "sleep");
+}
+
+void FramePacer::sleep_until(double deadline) {
+    double sleep_end = deadline - spin_margin;
+    double before = now();
+    if (sleep_end > before) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(sleep_end - before));
+
+        // learn how much the scheduler oversleeps and keep that much margin,
+        // slowly relaxing back when it behaves
+        double overslept = now() - sleep_end;
+        spin_margin = std::min(MAX_SPIN_MARGIN, std::max(spin_margin*0.99, overslept*1.5));
+    }
+    while (now() < deadline) {
+        // spin out the last fraction of a millisecond
+    }
+}
+
+double FramePacer::wait() {
+    double period = target_rate > 0 ? 1.0/target_rate : 0.0;
+
+    if (period > 0 && !use_vsync) {
+        if (now() - next_deadline > period) {
+            // too far behind to catch up, restart the schedule instead of
+            // rushing a burst of frames
+            next_deadline = now();
+        }
+        sleep_until(next_deadline);
+    }
+
+    double time = now();
+    double delta = time - last_frame;
+    if (last_frame > 0) {
+        intervals.add(delta);
+        if (period > 0 && !use_vsync) {
+            lateness.add(time - next_deadline);
+        }
+    }
+    last_frame = time;
+    next_deadline += period;
+
+    // some drivers ignore the swap interval, fall back to sleeping when the
+    // frames come in much faster than the refresh rate
+    if (use_vsync && ++vsync_checked_frames <= VSYNC_CHECK_FRAMES) {
+        vsync_checked_time += delta;
+        if (vsync_checked_frames == VSYNC_CHECK_FRAMES && vsync_checked_time < 0.8*VSYNC_CHECK_FRAMES*period) {
+            log("frame pacing: swap interval ignored by the driver, sleeping instead\n");
+            glfwSwapInterval(0);
+            use_vsync = false;
+            next_deadline = time + period;
+        }
+    }
+
+    return delta;
+}
+
+void FramePacer::report(FILE *file) {
+    StatsSummary frame = intervals.summarize();
+    if (frame.count == 0) {
+        return;
+    }
+    fprintf(file, "frames: %zu, interval ms min %.3f avg %.3f p50 %.3f p99 %.3f max %.3f (%.1f fps)\n",
+            frame.count, frame.min*1e3, frame.avg*1e3, frame.p50*1e3, frame.p99*1e3, frame.max*1e3,
+            1.0/frame.avg);
+
+    StatsSummary late = lateness.summarize();
+    if (late.count > 0) {
+        fprintf(file, "wake-up jitter ms avg %.3f p99 %.3f max %.3f (spin margin %.3f)\n",
+                late.avg*1e3, late.p99*1e3, late.max*1e3, spin_margin*1e3);
+    }
+}
@@ -0,0 +1,47 @@
+#ifndef FRAME_PACER_H
+#define FRAME_PACER_H
+
+#include "rolling_stats.h"
+#include <stdio.h>
+
+// caps the frame rate without burning a core. when the display refresh
+// matches the target rate the swap interval does the waiting, otherwise the
+// pacer sleeps until shortly before the deadline and spins only the rest
+class FramePacer {
+    private:
+        // frames per second, 0 for uncapped
+        double target_rate = 60;
+        bool use_vsync = false;
+
+        double start_time = 0;
+        double last_frame = 0;
+        double next_deadline = 0;
+        // how much earlier than the deadline to stop sleeping, grows with the
+        // oversleeps we observe
+        double spin_margin = 0.002;
+
+        // frames measured while checking the driver honours the swap interval
+        int vsync_checked_frames = 0;
+        double vsync_checked_time = 0;
+
+        // seconds between frame starts, and how late each frame started
+        RollingStats intervals, lateness;
+
+        double now();
+        void sleep_until(double deadline);
+
+    public:
+        FramePacer() {}
+
+        // rate is in frames per second (0 for uncapped). vsync is used when
+        // allowed and the refresh rate of the current display matches the rate
+        void setup(double rate, bool allow_vsync, int refresh_rate);
+
+        // wait for the next frame, returns the seconds since the last one
+        double wait();
+
+        // frame interval and jitter statistics over the last frames
+        void report(FILE *file);
+};
+
+#endif // FRAME_PACER_H
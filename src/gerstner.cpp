@@ -0,0 +1,306 @@
+#include "gerstner.h"
+#include "fast_math.h"
+#include <math.h>
+#include <stdio.h>
+
+#define PI 3.14159265359
+
+// points evaluated together, the accumulators of a block stay in L1
+#define GERSTNER_BLOCK 64
+
+static const char *BANK_HEADER = "ocean-breeze wave bank 1";
+
+bool GerstnerBank::add(const GerstnerWave &wave) {
+    float length = wave.direction.norm();
+    if ((int)waves.size() >= GERSTNER_MAX_WAVES || length <= 0 || wave.wavelength <= 0) {
+        return false;
+    }
+    GerstnerWave normalized = wave;
+    normalized.direction /= length;
+    waves.push_back(normalized);
+    rebuild();
+    return true;
+}
+
+void GerstnerBank::clear() {
+    waves.clear();
+    rebuild();
+}
+
+void GerstnerBank::rebuild() {
+    size_t count = waves.size();
+    wave_kx.resize(count);
+    wave_ky.resize(count);
+    shift_x.resize(count);
+    shift_y.resize(count);
+    amplitude.resize(count);
+    slope_x.resize(count);
+    slope_y.resize(count);
+    steep_xx.resize(count);
+    steep_xy.resize(count);
+    steep_yy.resize(count);
+
+    for (size_t i=0; i<count; i++) {
+        const GerstnerWave &wave = waves[i];
+        float k = 2*PI / wave.wavelength;
+        float dx = wave.direction[0], dy = wave.direction[1];
+        wave_kx[i] = dx*k;
+        wave_ky[i] = dy*k;
+        shift_x[i] = dx*wave.steepness/k;
+        shift_y[i] = dy*wave.steepness/k;
+        amplitude[i] = wave.amplitude;
+        slope_x[i] = dx*k*wave.amplitude;
+        slope_y[i] = dy*k*wave.amplitude;
+        steep_xx[i] = wave.steepness*dx*dx;
+        steep_xy[i] = wave.steepness*dx*dy;
+        steep_yy[i] = wave.steepness*dy*dy;
+    }
+    version++;
+}
+
+GerstnerBank GerstnerBank::default_bank() {
+    // sin(2x + a) travels towards -x, and sin(pi - theta) = sin(theta)
+    // turns it into the bank's k*dot(d, p) - omega*t form
+    GerstnerWave wave;
+    wave.direction = Eigen::Vector2f(-1, 0);
+    wave.wavelength = PI;
+    wave.amplitude = 0.2f;
+    wave.steepness = 0.0f;
+    // 10 degrees a second over k = 2
+    wave.speed = 10*PI/180 / 2;
+    wave.phase = PI;
+
+    GerstnerBank bank;
+    bank.add(wave);
+    return bank;
+}
+
+bool GerstnerBank::save(const std::string &path) {
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) {
+        return false;
+    }
+    fprintf(file, "%s\n", BANK_HEADER);
+    for (size_t i=0; i<waves.size(); i++) {
+        const GerstnerWave &wave = waves[i];
+        fprintf(file, "%.9g %.9g %.9g %.9g %.9g %.9g %.9g\n", wave.direction[0], wave.direction[1],
+                wave.wavelength, wave.amplitude, wave.steepness, wave.speed, wave.phase);
+    }
+    return fclose(file) == 0;
+}
+
+bool GerstnerBank::load(const std::string &path) {
+    FILE *file = fopen(path.c_str(), "r");
+    if (!file) {
+        return false;
+    }
+
+    char header[64];
+    bool ok = fgets(header, sizeof(header), file)
+        && std::string(header) == std::string(BANK_HEADER) + "\n";
+
+    GerstnerBank loaded;
+    GerstnerWave wave;
+    while (ok && fscanf(file, "%f %f %f %f %f %f %f", &wave.direction[0], &wave.direction[1],
+                &wave.wavelength, &wave.amplitude, &wave.steepness, &wave.speed, &wave.phase) == 7) {
+        ok = loaded.add(wave);
+    }
+    // anything left over is a malformed line
+    ok = ok && feof(file);
+    fclose(file);
+    if (!ok) {
+        return false;
+    }
+
+    waves.swap(loaded.waves);
+    rebuild();
+    return true;
+}
+
+void GerstnerBank::get_reach(float &horizontal, float &vertical) {
+    horizontal = vertical = 0;
+    for (size_t i=0; i<waves.size(); i++) {
+        horizontal += fabsf(waves[i].steepness) * waves[i].wavelength / (2*PI);
+        vertical += fabsf(waves[i].amplitude);
+    }
+}
+
+void GerstnerBank::pack_uniforms(std::vector<float> &data) {
+    data.assign(8*waves.size(), 0.0f);
+    for (size_t i=0; i<waves.size(); i++) {
+        const GerstnerWave &wave = waves[i];
+        float k = 2*PI / wave.wavelength;
+        float *a = &data[8*i], *b = a + 4;
+        a[0] = wave_kx[i];
+        a[1] = wave_ky[i];
+        a[2] = wave.amplitude;
+        a[3] = wave.steepness / k;
+        b[0] = wave.steepness;
+    }
+}
+
+// one wave over a block of points. the sums are the displacement and the
+// tangent terms
+static void accumulate_wave(int n, const float *__restrict x, const float *__restrict y,
+        float kx, float ky, float offset, float shift_x, float shift_y, float amplitude,
+        float slope_x, float slope_y, float steep_xx, float steep_xy, float steep_yy,
+        float *__restrict dx, float *__restrict dy, float *__restrict dz,
+        float *__restrict gx, float *__restrict gy,
+        float *__restrict sxx, float *__restrict sxy, float *__restrict syy) {
+    for (int i=0; i<n; i++) {
+        float s, c;
+        sincos_fast(kx*x[i] + ky*y[i] + offset, s, c);
+        dx[i] += shift_x*c;
+        dy[i] += shift_y*c;
+        dz[i] += amplitude*s;
+        gx[i] += slope_x*c;
+        gy[i] += slope_y*c;
+        sxx[i] += steep_xx*s;
+        sxy[i] += steep_xy*s;
+        syy[i] += steep_yy*s;
+    }
+}
+
+// displacement, slopes and the steepness terms of the tangents
+struct GerstnerBank::BlockSums {
+    float dx[GERSTNER_BLOCK], dy[GERSTNER_BLOCK], dz[GERSTNER_BLOCK];
+    float gx[GERSTNER_BLOCK], gy[GERSTNER_BLOCK];
+    float sxx[GERSTNER_BLOCK], sxy[GERSTNER_BLOCK], syy[GERSTNER_BLOCK];
+};
+
+void GerstnerBank::phase_offsets(float time, std::vector<float> &offsets) {
+    // reduced in double so long runs keep their precision. one spare entry
+    // so &offsets[0] is valid for an empty bank
+    offsets.assign(waves.size() + 1, 0.0f);
+    for (size_t w=0; w<waves.size(); w++) {
+        double k = 2*PI / waves[w].wavelength;
+        offsets[w] = fmod(waves[w].phase - k*waves[w].speed*(double)time, 2*PI);
+    }
+}
+
+void GerstnerBank::sum_block(int n, const float *x, const float *y, const float *offsets, BlockSums &sums) {
+    for (int i=0; i<n; i++) {
+        sums.dx[i] = sums.dy[i] = sums.dz[i] = sums.gx[i] = sums.gy[i] = 0;
+        sums.sxx[i] = sums.sxy[i] = sums.syy[i] = 0;
+    }
+    for (size_t w=0; w<waves.size(); w++) {
+        accumulate_wave(n, x, y, wave_kx[w], wave_ky[w], offsets[w],
+                shift_x[w], shift_y[w], amplitude[w], slope_x[w], slope_y[w],
+                steep_xx[w], steep_xy[w], steep_yy[w], sums.dx, sums.dy, sums.dz,
+                sums.gx, sums.gy, sums.sxx, sums.sxy, sums.syy);
+    }
+}
+
+// unit normals of a block from its sums: the cross product of the tangents
+// along x, (1 - sxx, -sxy, gx), and along y, (-sxy, 1 - syy, gy)
+static void block_normals(int n, const float *__restrict gx, const float *__restrict gy,
+        const float *__restrict sxx, const float *__restrict sxy, const float *__restrict syy,
+        float *__restrict normal_x, float *__restrict normal_y, float *__restrict normal_z) {
+    for (int i=0; i<n; i++) {
+        float tx = 1 - sxx[i], ty = 1 - syy[i];
+        float nx = -sxy[i]*gy[i] - gx[i]*ty;
+        float ny = -gx[i]*sxy[i] - tx*gy[i];
+        float nz = tx*ty - sxy[i]*sxy[i];
+        float scale = 1 / sqrtf(nx*nx + ny*ny + nz*nz);
+        normal_x[i] = nx*scale;
+        normal_y[i] = ny*scale;
+        normal_z[i] = nz*scale;
+    }
+}
+
+void GerstnerBank::evaluate(int count, const float *x, const float *y, float time,
+        float *position_x, float *position_y, float *position_z,
+        float *normal_x, float *normal_y, float *normal_z) {
+    std::vector<float> offsets;
+    phase_offsets(time, offsets);
+
+    BlockSums sums;
+    float nx[GERSTNER_BLOCK], ny[GERSTNER_BLOCK], nz[GERSTNER_BLOCK];
+    for (int first=0; first<count; first+=GERSTNER_BLOCK) {
+        int n = count - first < GERSTNER_BLOCK ? count - first : GERSTNER_BLOCK;
+        sum_block(n, x + first, y + first, &offsets[0], sums);
+
+        for (int i=0; i<n; i++) {
+            int index = first + i;
+            if (position_x) position_x[index] = x[index] + sums.dx[i];
+            if (position_y) position_y[index] = y[index] + sums.dy[i];
+            if (position_z) position_z[index] = sums.dz[i];
+        }
+        if (!normal_x && !normal_y && !normal_z) {
+            continue;
+        }
+        block_normals(n, sums.gx, sums.gy, sums.sxx, sums.sxy, sums.syy, nx, ny, nz);
+        for (int i=0; i<n; i++) {
+            int index = first + i;
+            if (normal_x) normal_x[index] = nx[i];
+            if (normal_y) normal_y[index] = ny[i];
+            if (normal_z) normal_z[index] = nz[i];
+        }
+    }
+}
+
+// one Newton step towards the rest points p with p + d(p) = q. the jacobian
+// of p + d(p) is [1 - sxx, -sxy; -sxy, 1 - syy]
+static void newton_step(int n, const float *__restrict qx, const float *__restrict qy,
+        const float *__restrict dx, const float *__restrict dy,
+        const float *__restrict sxx, const float *__restrict sxy, const float *__restrict syy,
+        float *__restrict px, float *__restrict py) {
+    for (int i=0; i<n; i++) {
+        float rx = px[i] + dx[i] - qx[i], ry = py[i] + dy[i] - qy[i];
+        float a = 1 - sxx[i], b = -sxy[i], d = 1 - syy[i];
+        float det = a*d - b*b;
+        // the surface folds where det reaches 0, keep the step bounded there
+        det = det < 0.01f ? 0.01f : det;
+        px[i] -= (d*rx - b*ry) / det;
+        py[i] -= (a*ry - b*rx) / det;
+    }
+}
+
+void GerstnerBank::query(WaterQuery &query, float time, Heightfield *ground) {
+    query.resize_outputs();
+    int count = query.size();
+    if (!count) {
+        return;
+    }
+
+    std::vector<float> offsets;
+    phase_offsets(time, offsets);
+
+    BlockSums sums;
+    for (int first=0; first<count; first+=GERSTNER_BLOCK) {
+        int n = count - first < GERSTNER_BLOCK ? count - first : GERSTNER_BLOCK;
+        const float *qx = &query.x[first], *qy = &query.y[first];
+        float *px = &query.rest_x[first], *py = &query.rest_y[first];
+
+        // start from the query points, the horizontal displacement is small
+        for (int i=0; i<n; i++) {
+            px[i] = qx[i];
+            py[i] = qy[i];
+        }
+        for (int step=0; step<GERSTNER_QUERY_STEPS; step++) {
+            sum_block(n, px, py, &offsets[0], sums);
+            newton_step(n, qx, qy, sums.dx, sums.dy, sums.sxx, sums.sxy, sums.syy, px, py);
+        }
+
+        sum_block(n, px, py, &offsets[0], sums);
+        for (int i=0; i<n; i++) {
+            query.height[first + i] = sums.dz[i];
+        }
+        if (ground) {
+            // slopes add up before the tangents are crossed, as in the shader
+            for (int i=0; i<n; i++) {
+                Eigen::Vector2f gradient;
+                query.height[first + i] += ground->sample(px[i], py[i], gradient);
+                sums.gx[i] += gradient[0];
+                sums.gy[i] += gradient[1];
+            }
+        }
+        block_normals(n, sums.gx, sums.gy, sums.sxx, sums.sxy, sums.syy,
+                &query.normal_x[first], &query.normal_y[first], &query.normal_z[first]);
+    }
+}
+
+void GerstnerBank::evaluate(float x, float y, float time, Eigen::Vector3f &position, Eigen::Vector3f &normal) {
+    evaluate(1, &x, &y, time, &position[0], &position[1], &position[2],
+            &normal[0], &normal[1], &normal[2]);
+}
@@ -0,0 +1,103 @@
+#ifndef GERSTNER_H
+#define GERSTNER_H
+
+#include "heightfield.h"
+#include "water_query.h"
+#include <Eigen/Core>
+#include <string>
+#include <vector>
+
+// waves the vertex shader can sum, its uniform arrays are this long
+#define GERSTNER_MAX_WAVES 16
+
+// Newton steps a query takes to find the point that moved over it
+#define GERSTNER_QUERY_STEPS 3
+
+// one travelling wave. the surface point at rest at p moves to
+// p + direction*steepness/k*cos(theta) horizontally and amplitude*sin(theta)
+// up, with theta = k*dot(direction, p) - k*speed*t + phase and k = 2 pi / wavelength
+struct GerstnerWave {
+    // direction of travel, normalized when the wave is added
+    Eigen::Vector2f direction = Eigen::Vector2f(1, 0);
+    float wavelength = 1.0f;
+    float amplitude = 0.1f;
+    // 0 for a sine, 1 for crests as sharp as they get before the surface
+    // folds over. keep the sum over the bank at or below 1 too
+    float steepness = 0.0f;
+    // units per second the crests travel
+    float speed = 1.0f;
+    // radians at the origin at time 0
+    float phase = 0.0f;
+};
+
+// a bank of Gerstner waves summed into one surface, drawn by vshader1.vert
+// and evaluated on the CPU with the same formulas so gameplay sees the
+// surface that is on screen
+class GerstnerBank {
+    private:
+        std::vector<GerstnerWave> waves;
+        // per wave, structure of arrays so the evaluator vectorizes over
+        // points: the wave vector, the horizontal and vertical amplitudes,
+        // the slope amplitudes k*amplitude and the steepness times the
+        // direction products the tangents need
+        std::vector<float> wave_kx, wave_ky;
+        std::vector<float> shift_x, shift_y, amplitude, slope_x, slope_y;
+        std::vector<float> steep_xx, steep_xy, steep_yy;
+        // bumped on every change so uploads can be skipped
+        unsigned version = 1;
+
+        // sums over the bank for a block of points, defined with the evaluator
+        struct BlockSums;
+
+        void rebuild();
+        void sum_block(int n, const float *x, const float *y, const float *offsets, BlockSums &sums);
+
+    public:
+        GerstnerBank() {}
+
+        // false if the bank is full or the wave has no length or direction
+        bool add(const GerstnerWave &wave);
+        void clear();
+
+        int get_count() { return waves.size(); }
+        const GerstnerWave &get(int index) { return waves[index]; }
+        unsigned get_version() { return version; }
+        // the furthest the bank can move a point sideways and up or down,
+        // the sums of the waves' steepness/k and amplitudes
+        void get_reach(float &horizontal, float &vertical);
+
+        // the single wave the vertex shader used to hard-code,
+        // sin(2x + angle)*0.2 with the angle turning 10 degrees a second
+        static GerstnerBank default_bank();
+
+        // a text file with a header line, then a wave per line: direction x
+        // and y, wavelength, amplitude, steepness, speed and phase. false if
+        // it can't be written, read or parsed
+        bool save(const std::string &path);
+        bool load(const std::string &path);
+
+        // the uniforms of vshader1.vert, two vec4s per wave: (kx, ky,
+        // amplitude, steepness/k) and (steepness, 0, 0, 0)
+        void pack_uniforms(std::vector<float> &data);
+        // the time dependent part of every wave's phase at time t, theta is
+        // k*dot(direction, p) plus it. reduced in double, the shaders take
+        // it as wave_phase so they evaluate the same bounded angles
+        void phase_offsets(float time, std::vector<float> &offsets);
+
+        // displaced positions and normals of count points at rest at (x, y)
+        // at time t (seconds). any output may be NULL
+        void evaluate(int count, const float *x, const float *y, float time,
+                float *position_x, float *position_y, float *position_z,
+                float *normal_x, float *normal_y, float *normal_z);
+        // same, for a single point
+        void evaluate(float x, float y, float time, Eigen::Vector3f &position, Eigen::Vector3f &normal);
+
+        // the surface above the query's world points at time t. the waves
+        // move points sideways, so the rest point that ends up above each
+        // one is found with Newton's method before evaluating it there. with
+        // ground, the waves ride on it like in vshader1.vert: its height and
+        // slopes at the rest point add to the surface's
+        void query(WaterQuery &query, float time, Heightfield *ground = NULL);
+};
+
+#endif // GERSTNER_H
@@ -0,0 +1,113 @@
+#include "gl_ext.h"
+#include <string.h>
+#include <stdio.h>
+
+GLExtensions glext;
+
+// cast the generic proc into the type of the function pointer it is stored in
+template <typename T>
+static bool resolve(GLProcLoader loader, T &fn, const char *name) {
+    fn = reinterpret_cast<T>(loader(name));
+    return fn != nullptr;
+}
+
+bool has_gl_extension(const char *name) {
+    size_t len = strlen(name);
+
+    // core profiles only expose the extensions one by one
+    if (glext.GetStringi && glext.version >= 30) {
+        GLint count = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        if (glGetError() == GL_NO_ERROR) {
+            for (GLint i=0; i<count; i++) {
+                const char *ext = (const char *)glext.GetStringi(GL_EXTENSIONS, i);
+                if (ext && strcmp(ext, name) == 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+
+    const char *exts = (const char *)glGetString(GL_EXTENSIONS);
+    if (!exts) {
+        return false;
+    }
+    // match whole space separated tokens only
+    for (const char *p = strstr(exts, name); p; p = strstr(p + len, name)) {
+        bool starts = p == exts || p[-1] == ' ';
+        bool ends = p[len] == ' ' || p[len] == '\0';
+        if (starts && ends) {
+            return true;
+        }
+    }
+    return false;
+}
+
+void load_gl_extensions(GLProcLoader loader) {
+    glext = GLExtensions();
+
+    int major = 0, minor = 0;
+    const char *version = (const char *)glGetString(GL_VERSION);
+    if (version) {
+        sscanf(version, "%d.%d", &major, &minor);
+    }
+    glext.version = major*10 + minor;
+
+    resolve(loader, glext.GetStringi, "glGetStringi");
+
+    if (glext.version >= 30 || has_gl_extension("GL_ARB_vertex_array_object")) {
+        glext.vertex_array = resolve(loader, glext.BindVertexArray, "glBindVertexArray");
+    }
+
+    if (glext.version >= 41 || has_gl_extension("GL_ARB_get_program_binary")) {
+        bool ok = resolve(loader, glext.GetProgramBinary, "glGetProgramBinary");
+        ok &= resolve(loader, glext.ProgramBinary, "glProgramBinary");
+        ok &= resolve(loader, glext.ProgramParameteri, "glProgramParameteri");
+
+        // drivers may expose the API with no formats, which makes it useless
+        GLint formats = 0;
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+        glext.program_binary = ok && formats > 0;
+    }
+
+    // the tessellation shaders also rely on GLSL 4.00 and float textures
+    if (glext.version >= 40) {
+        glext.tessellation = resolve(loader, glext.PatchParameteri, "glPatchParameteri");
+    }
+
+    // compute shaders are only useful to us together with storage buffers
+    if (glext.version >= 43 || (has_gl_extension("GL_ARB_compute_shader")
+                && has_gl_extension("GL_ARB_shader_storage_buffer_object"))) {
+        bool ok = resolve(loader, glext.BindBufferBase, "glBindBufferBase");
+        ok &= resolve(loader, glext.DispatchCompute, "glDispatchCompute");
+        ok &= resolve(loader, glext.MemoryBarrierGL, "glMemoryBarrier");
+        glext.compute = ok;
+    }
+
+    if (glext.version >= 33 || has_gl_extension("GL_ARB_timer_query")) {
+        bool ok = resolve(loader, glext.QueryCounter, "glQueryCounter");
+        ok &= resolve(loader, glext.GetQueryObjectui64v, "glGetQueryObjectui64v");
+        glext.timer_query = ok;
+    }
+
+    if (glext.version >= 32 || has_gl_extension("GL_ARB_sync")) {
+        bool ok = resolve(loader, glext.FenceSync, "glFenceSync");
+        ok &= resolve(loader, glext.ClientWaitSync, "glClientWaitSync");
+        ok &= resolve(loader, glext.DeleteSync, "glDeleteSync");
+        glext.sync = ok;
+    }
+
+    if (glext.version >= 30 || has_gl_extension("GL_ARB_framebuffer_object")) {
+        bool ok = resolve(loader, glext.GenFramebuffers, "glGenFramebuffers");
+        ok &= resolve(loader, glext.DeleteFramebuffers, "glDeleteFramebuffers");
+        ok &= resolve(loader, glext.BindFramebuffer, "glBindFramebuffer");
+        ok &= resolve(loader, glext.CheckFramebufferStatus, "glCheckFramebufferStatus");
+        ok &= resolve(loader, glext.FramebufferRenderbuffer, "glFramebufferRenderbuffer");
+        ok &= resolve(loader, glext.GenRenderbuffers, "glGenRenderbuffers");
+        ok &= resolve(loader, glext.DeleteRenderbuffers, "glDeleteRenderbuffers");
+        ok &= resolve(loader, glext.BindRenderbuffer, "glBindRenderbuffer");
+        ok &= resolve(loader, glext.RenderbufferStorage, "glRenderbufferStorage");
+        glext.framebuffer_object = ok;
+    }
+}
@@ -0,0 +1,180 @@
+#ifndef GL_EXT_H
+#define GL_EXT_H
+
+// OS X's gl.h only declares the OpenGL 2.1 API and we don't ship a loader, so
+// anything newer is resolved at runtime through the context's proc address
+#include <GLFW/glfw3.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifndef APIENTRY
+#define APIENTRY
+#endif
+
+// ARB_get_program_binary / GL 4.1
+#ifndef GL_PROGRAM_BINARY_RETRIEVABLE_HINT
+#define GL_PROGRAM_BINARY_RETRIEVABLE_HINT 0x8257
+#endif
+#ifndef GL_PROGRAM_BINARY_LENGTH
+#define GL_PROGRAM_BINARY_LENGTH 0x8741
+#endif
+#ifndef GL_NUM_PROGRAM_BINARY_FORMATS
+#define GL_NUM_PROGRAM_BINARY_FORMATS 0x87FE
+#endif
+
+// ARB_tessellation_shader / GL 4.0
+#ifndef GL_PATCHES
+#define GL_PATCHES 0x000E
+#endif
+#ifndef GL_PATCH_VERTICES
+#define GL_PATCH_VERTICES 0x8E72
+#endif
+#ifndef GL_TESS_EVALUATION_SHADER
+#define GL_TESS_EVALUATION_SHADER 0x8E87
+#endif
+#ifndef GL_TESS_CONTROL_SHADER
+#define GL_TESS_CONTROL_SHADER 0x8E88
+#endif
+
+// ARB_compute_shader / ARB_shader_storage_buffer_object / GL 4.3
+#ifndef GL_COMPUTE_SHADER
+#define GL_COMPUTE_SHADER 0x91B9
+#endif
+#ifndef GL_SHADER_STORAGE_BUFFER
+#define GL_SHADER_STORAGE_BUFFER 0x90D2
+#endif
+#ifndef GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT
+#define GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT 0x00000001
+#endif
+#ifndef GL_BUFFER_UPDATE_BARRIER_BIT
+#define GL_BUFFER_UPDATE_BARRIER_BIT 0x00000200
+#endif
+
+// ARB_timer_query / GL 3.3
+#ifndef GL_TIMESTAMP
+#define GL_TIMESTAMP 0x8E28
+#endif
+
+// ARB_framebuffer_object / GL 3.0
+#ifndef GL_FRAMEBUFFER
+#define GL_FRAMEBUFFER 0x8D40
+#endif
+#ifndef GL_RENDERBUFFER
+#define GL_RENDERBUFFER 0x8D41
+#endif
+#ifndef GL_FRAMEBUFFER_COMPLETE
+#define GL_FRAMEBUFFER_COMPLETE 0x8CD5
+#endif
+#ifndef GL_COLOR_ATTACHMENT0
+#define GL_COLOR_ATTACHMENT0 0x8CE0
+#endif
+#ifndef GL_DEPTH_ATTACHMENT
+#define GL_DEPTH_ATTACHMENT 0x8D00
+#endif
+#ifndef GL_DEPTH_COMPONENT24
+#define GL_DEPTH_COMPONENT24 0x81A6
+#endif
+
+// ARB_sync / GL 3.2
+#ifndef GL_SYNC_GPU_COMMANDS_COMPLETE
+#define GL_SYNC_GPU_COMMANDS_COMPLETE 0x9117
+#endif
+#ifndef GL_ALREADY_SIGNALED
+#define GL_ALREADY_SIGNALED 0x911A
+#endif
+#ifndef GL_TIMEOUT_EXPIRED
+#define GL_TIMEOUT_EXPIRED 0x911B
+#endif
+#ifndef GL_CONDITION_SATISFIED
+#define GL_CONDITION_SATISFIED 0x911C
+#endif
+#ifndef GL_SYNC_FLUSH_COMMANDS_BIT
+#define GL_SYNC_FLUSH_COMMANDS_BIT 0x00000001
+#endif
+
+#ifndef GL_UNIFORM_BUFFER
+#define GL_UNIFORM_BUFFER 0x8A11
+#endif
+#ifndef GL_PIXEL_PACK_BUFFER
+#define GL_PIXEL_PACK_BUFFER 0x88EB
+#endif
+
+#ifndef GL_R32F
+#define GL_R32F 0x822E
+#endif
+
+#ifndef GL_NUM_EXTENSIONS
+#define GL_NUM_EXTENSIONS 0x821D
+#endif
+
+typedef void (*GLProc)(void);
+typedef GLProc (*GLProcLoader)(const char *name);
+
+struct GLExtensions {
+    // context version, e.g. 41 for 4.1
+    int version = 0;
+
+    // feature flags, only set when every entry point of the feature resolved
+    bool vertex_array = false;
+    bool program_binary = false;
+    bool tessellation = false;
+    bool compute = false;
+    bool timer_query = false;
+    bool framebuffer_object = false;
+    bool sync = false;
+
+    // GL 3.0
+    const GLubyte *(APIENTRY *GetStringi)(GLenum name, GLuint index) = nullptr;
+
+    // ARB_vertex_array_object
+    void (APIENTRY *BindVertexArray)(GLuint array) = nullptr;
+
+    // ARB_get_program_binary
+    void (APIENTRY *GetProgramBinary)(GLuint program, GLsizei buf_size, GLsizei *length,
+            GLenum *binary_format, void *binary) = nullptr;
+    void (APIENTRY *ProgramBinary)(GLuint program, GLenum binary_format,
+            const void *binary, GLsizei length) = nullptr;
+    void (APIENTRY *ProgramParameteri)(GLuint program, GLenum pname, GLint value) = nullptr;
+
+    // ARB_tessellation_shader
+    void (APIENTRY *PatchParameteri)(GLenum pname, GLint value) = nullptr;
+
+    // ARB_compute_shader
+    void (APIENTRY *BindBufferBase)(GLenum target, GLuint index, GLuint buffer) = nullptr;
+    void (APIENTRY *DispatchCompute)(GLuint groups_x, GLuint groups_y, GLuint groups_z) = nullptr;
+    // glMemoryBarrier, renamed since MemoryBarrier is a macro in winnt.h
+    void (APIENTRY *MemoryBarrierGL)(GLbitfield barriers) = nullptr;
+
+    // ARB_timer_query
+    void (APIENTRY *QueryCounter)(GLuint id, GLenum target) = nullptr;
+    void (APIENTRY *GetQueryObjectui64v)(GLuint id, GLenum pname, uint64_t *params) = nullptr;
+
+    // ARB_sync, GLsync is an opaque pointer that gl.h 2.1 doesn't declare
+    void *(APIENTRY *FenceSync)(GLenum condition, GLbitfield flags) = nullptr;
+    GLenum (APIENTRY *ClientWaitSync)(void *sync, GLbitfield flags, uint64_t timeout) = nullptr;
+    void (APIENTRY *DeleteSync)(void *sync) = nullptr;
+
+    // ARB_framebuffer_object
+    void (APIENTRY *GenFramebuffers)(GLsizei n, GLuint *framebuffers) = nullptr;
+    void (APIENTRY *DeleteFramebuffers)(GLsizei n, const GLuint *framebuffers) = nullptr;
+    void (APIENTRY *BindFramebuffer)(GLenum target, GLuint framebuffer) = nullptr;
+    GLenum (APIENTRY *CheckFramebufferStatus)(GLenum target) = nullptr;
+    void (APIENTRY *FramebufferRenderbuffer)(GLenum target, GLenum attachment,
+            GLenum renderbuffer_target, GLuint renderbuffer) = nullptr;
+    void (APIENTRY *GenRenderbuffers)(GLsizei n, GLuint *renderbuffers) = nullptr;
+    void (APIENTRY *DeleteRenderbuffers)(GLsizei n, const GLuint *renderbuffers) = nullptr;
+    void (APIENTRY *BindRenderbuffer)(GLenum target, GLuint renderbuffer) = nullptr;
+    void (APIENTRY *RenderbufferStorage)(GLenum target, GLenum internal_format,
+            GLsizei width, GLsizei height) = nullptr;
+};
+
+extern GLExtensions glext;
+
+// resolve the entry points of the current context with the given loader
+// (glfwGetProcAddress, eglGetProcAddress, ...)
+void load_gl_extensions(GLProcLoader loader);
+
+// true if the current context advertises the named extension
+bool has_gl_extension(const char *name);
+
+#endif // GL_EXT_H
@@ -0,0 +1,208 @@
+#include "gl_state.h"
+#include <string.h>
+
+GLStateCache gl_state;
+
+void GLStateCache::invalidate() {
+    program_known = vertex_array_known = polygon_mode_known = viewport_known = false;
+    texture_known = false;
+    for(int i=0; i<SLOT_COUNT; i++) {
+        buffer_known[i] = false;
+    }
+    capabilities.clear();
+    uniforms.clear();
+}
+
+void GLStateCache::forget_program(GLuint id) {
+    if (program_known && program == id) {
+        program_known = false;
+    }
+    // the cached values of the program are keyed by its name
+    for (std::unordered_map<uint64_t, UniformValue>::iterator it = uniforms.begin(); it != uniforms.end(); ) {
+        if ((GLuint)(it->first >> 32) == id) {
+            it = uniforms.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void GLStateCache::forget_buffer(GLuint id) {
+    for(int i=0; i<SLOT_COUNT; i++) {
+        if (buffer_known[i] && buffers[i] == id) {
+            buffer_known[i] = false;
+        }
+    }
+}
+
+int GLStateCache::buffer_slot(GLenum target) {
+    switch (target) {
+        case GL_ARRAY_BUFFER:
+            return SLOT_ARRAY;
+        case GL_ELEMENT_ARRAY_BUFFER:
+            return SLOT_ELEMENT_ARRAY;
+        case GL_PIXEL_PACK_BUFFER:
+            return SLOT_PIXEL_PACK;
+        case GL_UNIFORM_BUFFER:
+            return SLOT_UNIFORM;
+        case GL_SHADER_STORAGE_BUFFER:
+            return SLOT_SHADER_STORAGE;
+    }
+    return -1;
+}
+
+bool GLStateCache::issue(bool changed) {
+    if (changed) {
+        issued_calls++;
+    } else {
+        skipped_calls++;
+    }
+    return changed;
+}
+
+void GLStateCache::use_program(GLuint id) {
+    if (issue(!program_known || program != id)) {
+        glUseProgram(id);
+        program = id;
+        program_known = true;
+    }
+}
+
+GLuint GLStateCache::get_program() {
+    if (!program_known) {
+        GLint current = 0;
+        glGetIntegerv(GL_CURRENT_PROGRAM, &current);
+        program = current;
+        program_known = true;
+    }
+    return program;
+}
+
+void GLStateCache::bind_buffer(GLenum target, GLuint id) {
+    int slot = buffer_slot(target);
+    if (slot < 0) {
+        issue(true);
+        glBindBuffer(target, id);
+        return;
+    }
+    if (issue(!buffer_known[slot] || buffers[slot] != id)) {
+        glBindBuffer(target, id);
+        buffers[slot] = id;
+        buffer_known[slot] = true;
+    }
+}
+
+void GLStateCache::bind_buffer_base(GLenum target, GLuint index, GLuint id) {
+    issue(true);
+    glext.BindBufferBase(target, index, id);
+    int slot = buffer_slot(target);
+    if (slot >= 0) {
+        buffers[slot] = id;
+        buffer_known[slot] = true;
+    }
+}
+
+void GLStateCache::bind_vertex_array(GLuint id) {
+    if (issue(!vertex_array_known || vertex_array != id)) {
+        glext.BindVertexArray(id);
+        vertex_array = id;
+        vertex_array_known = true;
+        // the element array binding is part of the vertex array object
+        buffer_known[SLOT_ELEMENT_ARRAY] = false;
+    }
+}
+
+void GLStateCache::bind_texture(GLuint id) {
+    if (issue(!texture_known || texture != id)) {
+        glBindTexture(GL_TEXTURE_2D, id);
+        texture = id;
+        texture_known = true;
+    }
+}
+
+void GLStateCache::polygon_mode(GLenum mode) {
+    if (issue(!polygon_mode_known || polygon_mode_value != mode)) {
+        glPolygonMode(GL_FRONT_AND_BACK, mode);
+        polygon_mode_value = mode;
+        polygon_mode_known = true;
+    }
+}
+
+void GLStateCache::set_enabled(GLenum capability, bool enabled) {
+    std::map<GLenum, bool>::iterator it = capabilities.find(capability);
+    if (issue(it == capabilities.end() || it->second != enabled)) {
+        if (enabled) {
+            glEnable(capability);
+        } else {
+            glDisable(capability);
+        }
+        capabilities[capability] = enabled;
+    }
+}
+
+void GLStateCache::viewport(GLint x, GLint y, GLsizei w, GLsizei h) {
+    bool changed = !viewport_known || viewport_rect[0] != x || viewport_rect[1] != y
+        || viewport_rect[2] != w || viewport_rect[3] != h;
+    if (issue(changed)) {
+        glViewport(x, y, w, h);
+        viewport_rect[0] = x;
+        viewport_rect[1] = y;
+        viewport_rect[2] = w;
+        viewport_rect[3] = h;
+        viewport_known = true;
+    }
+}
+
+bool GLStateCache::uniform_changed(GLint location, GLenum type, const void *value, size_t size) {
+    if (location < 0) {
+        // GL ignores inactive uniforms anyway
+        return issue(false);
+    }
+    uint64_t key = ((uint64_t)get_program() << 32) | (uint32_t)location;
+    UniformValue &cached = uniforms[key];
+    if (cached.type == type && memcmp(cached.bits, value, size) == 0) {
+        return issue(false);
+    }
+    cached.type = type;
+    memcpy(cached.bits, value, size);
+    return issue(true);
+}
+
+void GLStateCache::uniform1i(GLint location, GLint x) {
+    if (uniform_changed(location, GL_INT, &x, sizeof(x))) {
+        glUniform1i(location, x);
+    }
+}
+
+void GLStateCache::uniform1f(GLint location, GLfloat x) {
+    if (uniform_changed(location, GL_FLOAT, &x, sizeof(x))) {
+        glUniform1f(location, x);
+    }
+}
+
+void GLStateCache::uniform2i(GLint location, GLint x, GLint y) {
+    GLint value[2] = { x, y };
+    if (uniform_changed(location, GL_INT_VEC2, value, sizeof(value))) {
+        glUniform2i(location, x, y);
+    }
+}
+
+void GLStateCache::uniform2f(GLint location, GLfloat x, GLfloat y) {
+    GLfloat value[2] = { x, y };
+    if (uniform_changed(location, GL_FLOAT_VEC2, value, sizeof(value))) {
+        glUniform2f(location, x, y);
+    }
+}
+
+void GLStateCache::end_frame() {
+    frames++;
+}
+
+void GLStateCache::report(FILE *file) {
+    unsigned long total = issued_calls + skipped_calls;
+    if (total == 0 || frames == 0) {
+        return;
+    }
+    fprintf(file, "gl state: %lu calls issued, %lu redundant skipped (%.1f%%), %.1f issued per frame\n",
+            issued_calls, skipped_calls, 100.0*skipped_calls/total, (double)issued_calls/frames);
+}
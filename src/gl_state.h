@@ -0,0 +1,86 @@
+#ifndef GL_STATE_H
+#define GL_STATE_H
+
+#include "gl_ext.h"
+#include <stdio.h>
+#include <map>
+#include <unordered_map>
+
+// remembers the GL state we set and skips calls that wouldn't change it,
+// counting both so the driver overhead of a frame is visible. everything
+// starts out unknown, so the first call of each kind always reaches GL.
+// code that changes state behind the cache's back must invalidate() it
+class GLStateCache {
+    private:
+        // buffer targets we track, anything else is always passed through
+        enum BufferSlot {
+            SLOT_ARRAY,
+            SLOT_ELEMENT_ARRAY,
+            SLOT_PIXEL_PACK,
+            SLOT_UNIFORM,
+            SLOT_SHADER_STORAGE,
+            SLOT_COUNT
+        };
+
+        // raw bits of up to four components, compared as a whole
+        struct UniformValue {
+            GLenum type;
+            uint32_t bits[4];
+        };
+
+        bool program_known, vertex_array_known, polygon_mode_known, viewport_known;
+        GLuint program, vertex_array;
+        GLenum polygon_mode_value;
+        GLint viewport_rect[4];
+        bool buffer_known[SLOT_COUNT];
+        GLuint buffers[SLOT_COUNT];
+        // texture bound to GL_TEXTURE_2D
+        bool texture_known;
+        GLuint texture;
+        // enable bits by capability, absent means unknown
+        std::map<GLenum, bool> capabilities;
+        // uniform values by (program << 32 | location)
+        std::unordered_map<uint64_t, UniformValue> uniforms;
+
+        unsigned long issued_calls = 0, skipped_calls = 0, frames = 0;
+
+        int buffer_slot(GLenum target);
+        // true if the call has to be issued, updating the counters either way
+        bool issue(bool changed);
+        bool uniform_changed(GLint location, GLenum type, const void *value, size_t size);
+
+    public:
+        GLStateCache() { invalidate(); }
+
+        // forget everything, the next call of each kind reaches GL
+        void invalidate();
+        // forget objects about to be deleted, their names may be reused
+        void forget_program(GLuint id);
+        void forget_buffer(GLuint id);
+
+        void use_program(GLuint id);
+        GLuint get_program();
+        void bind_buffer(GLenum target, GLuint id);
+        // binds an indexed target, which also binds the buffer to the
+        // generic target. the indexed binding itself isn't cached
+        void bind_buffer_base(GLenum target, GLuint index, GLuint id);
+        void bind_vertex_array(GLuint id);
+        void bind_texture(GLuint id);
+        void polygon_mode(GLenum mode);
+        void set_enabled(GLenum capability, bool enabled);
+        void viewport(GLint x, GLint y, GLsizei w, GLsizei h);
+
+        // uniforms of the current program
+        void uniform1i(GLint location, GLint x);
+        void uniform1f(GLint location, GLfloat x);
+        void uniform2i(GLint location, GLint x, GLint y);
+        void uniform2f(GLint location, GLfloat x, GLfloat y);
+
+        // count a frame for the per frame averages of the report
+        void end_frame();
+        void report(FILE *file);
+};
+
+extern GLStateCache gl_state;
+
+#endif // GL_STATE_H
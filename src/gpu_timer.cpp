@@ -0,0 +1,124 @@
+#include "gpu_timer.h"
+#include "logger.h"
+#include <string.h>
+
+bool GpuTimer::setup() {
+    if (!glext.timer_query) {
+        log("timer queries need OpenGL 3.3, gpu timing disabled\n");
+        return false;
+    }
+    for(int i=0; i<GPU_TIMER_LATENCY; i++) {
+        glGenQueries(GPU_TIMER_MAX_QUERIES, frames[i].queries);
+    }
+    enabled = true;
+    return true;
+}
+
+int GpuTimer::find_pass(const char *name) {
+    for(size_t i=0; i<passes.size(); i++) {
+        if (passes[i].name == name) {
+            return i;
+        }
+    }
+    passes.push_back(Pass(name));
+    return passes.size() - 1;
+}
+
+bool GpuTimer::collect(Frame &frame) {
+    // queries complete in order, so the last one issued tells for the whole
+    // frame
+    GLint available = GL_FALSE;
+    glGetQueryObjectiv(frame.queries[frame.last_query], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available) {
+        return false;
+    }
+
+    for(int i=0; i<frame.query_count; i+=2) {
+        uint64_t begin = 0, end = 0;
+        glext.GetQueryObjectui64v(frame.queries[i], GL_QUERY_RESULT, &begin);
+        glext.GetQueryObjectui64v(frame.queries[i+1], GL_QUERY_RESULT, &end);
+
+        passes[frame.passes[i/2]].samples.add((end - begin) / 1e6);
+    }
+    frame.pending = false;
+    return true;
+}
+
+void GpuTimer::begin_frame() {
+    if (!enabled) {
+        return;
+    }
+    Frame &frame = frames[current];
+    // if the GPU is more than GPU_TIMER_LATENCY frames behind, skip timing
+    // this frame rather than stall on the old results
+    recording = !frame.pending || collect(frame);
+    if (recording) {
+        frame.query_count = 0;
+    } else {
+        dropped_frames++;
+    }
+    open_passes.clear();
+}
+
+void GpuTimer::end_frame() {
+    if (!enabled) {
+        return;
+    }
+    if (recording) {
+        Frame &frame = frames[current];
+        frame.pending = frame.query_count > 0;
+    }
+    current = (current + 1) % GPU_TIMER_LATENCY;
+}
+
+void GpuTimer::begin_pass(const char *name) {
+    Frame &frame = frames[current];
+    if (!recording || frame.query_count >= GPU_TIMER_MAX_QUERIES) {
+        // keep begin/end balanced even when this pass isn't recorded
+        open_passes.push_back(-1);
+        return;
+    }
+
+    // reserve the end query right after the begin one
+    int query = frame.query_count;
+    frame.passes[query/2] = find_pass(name);
+    frame.query_count += 2;
+    glext.QueryCounter(frame.queries[query], GL_TIMESTAMP);
+    frame.last_query = query;
+    open_passes.push_back(query);
+}
+
+void GpuTimer::end_pass() {
+    if (open_passes.empty()) {
+        return;
+    }
+    int query = open_passes.back();
+    open_passes.pop_back();
+    if (query >= 0) {
+        Frame &frame = frames[current];
+        glext.QueryCounter(frame.queries[query+1], GL_TIMESTAMP);
+        frame.last_query = query + 1;
+    }
+}
+
+void GpuTimer::report(FILE *file) {
+    if (!enabled) {
+        return;
+    }
+    fprintf(file, "%-16s %8s %10s %10s %10s\n", "gpu pass", "samples", "min ms", "avg ms", "p99 ms");
+    for(size_t i=0; i<passes.size(); i++) {
+        StatsSummary stats = passes[i].samples.summarize();
+        if (stats.count == 0) {
+            continue;
+        }
+        fprintf(file, "%-16s %8zu %10.3f %10.3f %10.3f\n", passes[i].name.c_str(), stats.count,
+                stats.min, stats.avg, stats.p99);
+    }
+    if (dropped_frames > 0) {
+        fprintf(file, "(%d frames not timed, the GPU was too far behind)\n", dropped_frames);
+    }
+}
+
+bool GpuTimer::is_enabled() {
+    return enabled;
+}
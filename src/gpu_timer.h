@@ -0,0 +1,87 @@
+#ifndef GPU_TIMER_H
+#define GPU_TIMER_H
+
+#include "gl_ext.h"
+#include "rolling_stats.h"
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+// how many frames a query result is read back after it was issued, so the
+// CPU never waits on the GPU for a result
+#define GPU_TIMER_LATENCY 4
+// timestamps one frame can record, two per pass
+#define GPU_TIMER_MAX_QUERIES 32
+// samples kept per pass for the statistics
+#define GPU_TIMER_WINDOW 600
+
+// measures how long the GPU spends on each named pass of a frame with
+// GL_TIMESTAMP queries. a frame's queries live in a ring and are only read
+// once the driver reports them available, a few frames later
+class GpuTimer {
+    private:
+        struct Pass {
+            std::string name;
+            // durations in milliseconds
+            RollingStats samples;
+
+            Pass(const char *name): name(name), samples(GPU_TIMER_WINDOW) {}
+        };
+
+        struct Frame {
+            GLuint queries[GPU_TIMER_MAX_QUERIES];
+            // pass of each begin/end query pair
+            int passes[GPU_TIMER_MAX_QUERIES/2];
+            int query_count = 0;
+            // the query issued last, with nested passes an outer end comes
+            // after the inner ones but sits before them in queries
+            int last_query = 0;
+            bool pending = false;
+        };
+
+        bool enabled = false;
+        // false while the current slot's previous results are still in flight
+        bool recording = false;
+        Frame frames[GPU_TIMER_LATENCY];
+        int current = 0;
+        // frames recorded while every slot was still in flight
+        int dropped_frames = 0;
+        // query index of each open pass
+        std::vector<int> open_passes;
+        std::vector<Pass> passes;
+
+        int find_pass(const char *name);
+        // read back a frame if its results are ready, false if still in flight
+        bool collect(Frame &frame);
+
+    public:
+        GpuTimer() {}
+
+        // allocate the queries, false if the context has no timer queries
+        bool setup();
+
+        // call once per frame before the first pass and after the last one
+        void begin_frame();
+        void end_frame();
+
+        // passes may nest, each end_pass closes the latest begin_pass
+        void begin_pass(const char *name);
+        void end_pass();
+
+        // min/avg/p99 per pass over the sample window
+        void report(FILE *file);
+
+        bool is_enabled();
+};
+
+// times the GPU work issued in a scope as a pass of the timer
+class GpuPassScope {
+    private:
+        GpuTimer &timer;
+
+    public:
+        GpuPassScope(GpuTimer &timer, const char *name): timer(timer) { timer.begin_pass(name); }
+        ~GpuPassScope() { timer.end_pass(); }
+};
+
+#endif // GPU_TIMER_H
@@ -0,0 +1,169 @@
+#include "heightfield.h"
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+using namespace Eigen;
+
+// header of a saved heightfield, followed by columns*rows float heights
+struct HeightfieldHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t columns, rows;
+    float origin_x, origin_y, spacing;
+};
+
+static const char HEIGHTFIELD_MAGIC[4] = { 'O', 'B', 'H', 'F' };
+static const uint32_t HEIGHTFIELD_VERSION = 1;
+
+Heightfield::Heightfield(int columns, int rows, float origin_x, float origin_y, float spacing):
+    columns(columns), rows(rows), origin_x(origin_x), origin_y(origin_y), spacing(spacing),
+    heights(columns*rows), normals(columns*rows) {}
+
+void Heightfield::generate(PNoise &noise) {
+    generate_rows(noise, 0, rows);
+}
+
+void Heightfield::generate(PNoise &noise, ThreadPool &pool) {
+    // a few rows per chunk keeps the scheduling cheap next to the noise
+    int grain = std::max(1, 4096 / std::max(1, columns));
+    pool.parallel_for(rows, grain, [&](int begin, int end) {
+        generate_rows(noise, begin, end);
+    });
+}
+
+void Heightfield::generate_rows(PNoise &noise, int begin, int end) {
+    if (noise.get_warp_strength() != 0) {
+        generate_warped_rows(noise, begin, end);
+        return;
+    }
+    for(int j=begin; j<end; j++) {
+        for(int i=0; i<columns; i++) {
+            Vector2f gradient;
+            heights[index(i, j)] = noise.get_height_gradient2D(get_x(i), get_y(j), gradient);
+
+            // (1, 0, dz/dx) x (0, 1, dz/dy)
+            normals[index(i, j)] = Vector3f(-gradient[0], -gradient[1], 1).normalized();
+        }
+    }
+}
+
+void Heightfield::generate_warped_rows(PNoise &noise, int begin, int end) {
+    // a row at a time through the batched evaluator
+    static thread_local std::vector<float> x, y, gradient_x, gradient_y;
+    x.resize(columns);
+    y.resize(columns);
+    gradient_x.resize(columns);
+    gradient_y.resize(columns);
+    for(int i=0; i<columns; i++) {
+        x[i] = get_x(i);
+    }
+    for(int j=begin; j<end; j++) {
+        std::fill(y.begin(), y.end(), get_y(j));
+        noise.get_warped_heights2D(columns, &x[0], &y[0], &heights[index(0, j)], &gradient_x[0], &gradient_y[0]);
+        for(int i=0; i<columns; i++) {
+            normals[index(i, j)] = Vector3f(-gradient_x[i], -gradient_y[i], 1).normalized();
+        }
+    }
+}
+
+void Heightfield::generate(WorleyNoise &noise) {
+    generate_rows(noise, 0, rows);
+    compute_normals();
+}
+
+void Heightfield::generate(WorleyNoise &noise, ThreadPool &pool) {
+    int grain = std::max(1, 4096 / std::max(1, columns));
+    pool.parallel_for(rows, grain, [&](int begin, int end) {
+        generate_rows(noise, begin, end);
+    });
+    compute_normals();
+}
+
+void Heightfield::generate_rows(WorleyNoise &noise, int begin, int end) {
+    static thread_local std::vector<float> x, y;
+    x.resize(columns);
+    y.resize(columns);
+    for(int i=0; i<columns; i++) {
+        x[i] = get_x(i);
+    }
+    for(int j=begin; j<end; j++) {
+        std::fill(y.begin(), y.end(), get_y(j));
+        noise.get_heights2D(columns, &x[0], &y[0], &heights[index(0, j)]);
+    }
+}
+
+void Heightfield::compute_normals() {
+    for(int j=0; j<rows; j++) {
+        for(int i=0; i<columns; i++) {
+            // one sided at the borders
+            int i0 = std::max(i - 1, 0), i1 = std::min(i + 1, columns - 1);
+            int j0 = std::max(j - 1, 0), j1 = std::min(j + 1, rows - 1);
+            float dx = i1 > i0 ? (heights[index(i1, j)] - heights[index(i0, j)]) / ((i1 - i0)*spacing) : 0;
+            float dy = j1 > j0 ? (heights[index(i, j1)] - heights[index(i, j0)]) / ((j1 - j0)*spacing) : 0;
+            normals[index(i, j)] = Vector3f(-dx, -dy, 1).normalized();
+        }
+    }
+}
+
+bool Heightfield::save(const std::string &path) {
+    HeightfieldHeader header;
+    memcpy(header.magic, HEIGHTFIELD_MAGIC, sizeof(HEIGHTFIELD_MAGIC));
+    header.version = HEIGHTFIELD_VERSION;
+    header.columns = columns;
+    header.rows = rows;
+    header.origin_x = origin_x;
+    header.origin_y = origin_y;
+    header.spacing = spacing;
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(&heights[0], sizeof(float), heights.size(), file) == heights.size();
+    ok &= fclose(file) == 0;
+    return ok;
+}
+
+bool Heightfield::load(const std::string &path) {
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    HeightfieldHeader header;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1
+        && memcmp(header.magic, HEIGHTFIELD_MAGIC, sizeof(HEIGHTFIELD_MAGIC)) == 0
+        && header.version == HEIGHTFIELD_VERSION
+        && header.columns > 0 && header.rows > 0;
+    std::vector<float> values;
+    if (ok) {
+        values.resize((size_t)header.columns * header.rows);
+        ok = fread(&values[0], sizeof(float), values.size(), file) == values.size();
+    }
+    fclose(file);
+    if (!ok) {
+        return false;
+    }
+
+    *this = Heightfield(header.columns, header.rows, header.origin_x, header.origin_y, header.spacing);
+    heights.swap(values);
+    compute_normals();
+    return true;
+}
+
+float Heightfield::sample(float x, float y, Vector2f &gradient) {
+    float u = (x - origin_x) / spacing, v = (y - origin_y) / spacing;
+    u = std::min(std::max(u, 0.0f), columns - 1.0f);
+    v = std::min(std::max(v, 0.0f), rows - 1.0f);
+    // the last cell for points on the far edges
+    int i = std::min((int)u, columns - 2), j = std::min((int)v, rows - 2);
+    float tu = u - i, tv = v - j;
+
+    float a = heights[index(i, j)], b = heights[index(i+1, j)];
+    float c = heights[index(i, j+1)], d = heights[index(i+1, j+1)];
+    gradient = Vector2f(((b - a)*(1 - tv) + (d - c)*tv) / spacing,
+            ((c - a)*(1 - tu) + (d - b)*tu) / spacing);
+    return (a*(1 - tu) + b*tu)*(1 - tv) + (c*(1 - tu) + d*tu)*tv;
+}
@@ -0,0 +1,56 @@
+#ifndef HEIGHTFIELD_H
+#define HEIGHTFIELD_H
+
+#include "pnoise.h"
+#include "thread_pool.h"
+#include "worley.h"
+#include <Eigen/Core>
+#include <string>
+#include <vector>
+
+// a regular grid of heights and normals stored row after row, the point in
+// column i of row j sits at (origin_x + i*spacing, origin_y + j*spacing)
+class Heightfield {
+    public:
+        int columns = 0, rows = 0;
+        float origin_x = 0, origin_y = 0, spacing = 1;
+
+        std::vector<float> heights;
+        std::vector<Eigen::Vector3f> normals;
+
+        // constructors
+        Heightfield() {}
+        Heightfield(int columns, int rows, float origin_x, float origin_y, float spacing);
+
+        // sample the noise and its analytic normal at every grid point,
+        // warped when the noise has a warp strength
+        void generate(PNoise &noise);
+        // same, with the rows split over the pool
+        void generate(PNoise &noise, ThreadPool &pool);
+        // the same for cellular noise, with normals from the heights
+        void generate(WorleyNoise &noise);
+        void generate(WorleyNoise &noise, ThreadPool &pool);
+
+        // the binary cache format: a header with the grid layout followed by
+        // the heights, normals are rebuilt from the heights on load. false
+        // if the file can't be written, read or isn't a heightfield
+        bool save(const std::string &path);
+        bool load(const std::string &path);
+        // central differences of the heights, for grids without a noise
+        void compute_normals();
+
+        // bilinear height at world (x, y) and its gradient, clamped to the grid
+        float sample(float x, float y, Eigen::Vector2f &gradient);
+
+        // index of column i, row j in heights and normals
+        int index(int i, int j) { return j*columns + i; }
+        float get_x(int i) { return origin_x + i*spacing; }
+        float get_y(int j) { return origin_y + j*spacing; }
+
+    private:
+        void generate_rows(PNoise &noise, int begin, int end);
+        void generate_warped_rows(PNoise &noise, int begin, int end);
+        void generate_rows(WorleyNoise &noise, int begin, int end);
+};
+
+#endif // HEIGHTFIELD_H
@@ -0,0 +1,154 @@
+#include "image_io.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+// writes big endian, the byte order of every format here
+static void put_be16(std::vector<uint8_t> &out, uint16_t value) {
+    out.push_back(value >> 8);
+    out.push_back(value & 0xff);
+}
+
+static void put_be32(std::vector<uint8_t> &out, uint32_t value) {
+    out.push_back(value >> 24);
+    out.push_back((value >> 16) & 0xff);
+    out.push_back((value >> 8) & 0xff);
+    out.push_back(value & 0xff);
+}
+
+static bool write_file(const std::string &path, const void *header, size_t header_size,
+        const void *data, size_t data_size) {
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(header, 1, header_size, file) == header_size
+        && (data_size == 0 || fwrite(data, 1, data_size, file) == data_size);
+    ok &= fclose(file) == 0;
+    return ok;
+}
+
+// copy samples into a big endian byte stream
+static void append_samples(std::vector<uint8_t> &out, const void *pixels, size_t samples, int bits) {
+    if (bits == 8) {
+        const uint8_t *p = (const uint8_t *)pixels;
+        out.insert(out.end(), p, p + samples);
+    } else {
+        const uint16_t *p = (const uint16_t *)pixels;
+        for (size_t i=0; i<samples; i++) {
+            put_be16(out, p[i]);
+        }
+    }
+}
+
+bool write_pgm(const std::string &path, int width, int height, int bits, const void *pixels) {
+    char header[64];
+    int header_size = snprintf(header, sizeof(header), "P5\n%d %d\n%d\n", width, height, bits == 16 ? 65535 : 255);
+    std::vector<uint8_t> data;
+    data.reserve((size_t)width * height * (bits / 8));
+    append_samples(data, pixels, (size_t)width * height, bits);
+    return write_file(path, header, header_size, &data[0], data.size());
+}
+
+bool write_ppm(const std::string &path, int width, int height, const uint8_t *pixels) {
+    char header[64];
+    int header_size = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width, height);
+    return write_file(path, header, header_size, pixels, (size_t)width * height * 3);
+}
+
+static uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0) {
+    static uint32_t table[256];
+    static bool initialized = false;
+    if (!initialized) {
+        for (uint32_t i=0; i<256; i++) {
+            uint32_t c = i;
+            for (int k=0; k<8; k++) {
+                c = c & 1 ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            }
+            table[i] = c;
+        }
+        initialized = true;
+    }
+    crc = ~crc;
+    for (size_t i=0; i<size; i++) {
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+static void put_chunk(std::vector<uint8_t> &out, const char *type, const std::vector<uint8_t> &data) {
+    put_be32(out, data.size());
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    put_be32(out, crc32(&out[start], out.size() - start));
+}
+
+bool write_png(const std::string &path, int width, int height, int channels, int bits, const void *pixels) {
+    static const uint8_t color_types[5] = { 0, 0, 0, 2, 6 };
+    if (channels < 1 || channels > 4 || channels == 2 || (bits != 8 && bits != 16)) {
+        return false;
+    }
+
+    // filter type 0 (none) in front of every row
+    size_t row_samples = (size_t)width * channels;
+    size_t row_bytes = row_samples * (bits / 8);
+    std::vector<uint8_t> raw;
+    raw.reserve((row_bytes + 1) * height);
+    for (int y=0; y<height; y++) {
+        raw.push_back(0);
+        append_samples(raw, (const uint8_t *)pixels + y * row_samples * (bits / 8), row_samples, bits);
+    }
+
+    // a zlib stream of stored deflate blocks, at most 65535 bytes each
+    std::vector<uint8_t> zlib;
+    zlib.reserve(raw.size() + raw.size() / 65535 * 5 + 16);
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    uint32_t a = 1, b = 0;
+    for (size_t offset=0; offset<raw.size() || offset == 0; ) {
+        size_t block = std::min<size_t>(65535, raw.size() - offset);
+        bool last = offset + block == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(block & 0xff);
+        zlib.push_back(block >> 8);
+        zlib.push_back(~block & 0xff);
+        zlib.push_back((~block >> 8) & 0xff);
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + block);
+        for (size_t i=offset; i<offset+block; i++) {
+            a = (a + raw[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        offset += block;
+        if (last) {
+            break;
+        }
+    }
+    put_be32(zlib, (b << 16) | a);
+
+    std::vector<uint8_t> out;
+    static const uint8_t signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+    out.insert(out.end(), signature, signature + 8);
+
+    std::vector<uint8_t> ihdr;
+    put_be32(ihdr, width);
+    put_be32(ihdr, height);
+    ihdr.push_back(bits);
+    ihdr.push_back(color_types[channels]);
+    ihdr.push_back(0); // deflate
+    ihdr.push_back(0); // adaptive filtering
+    ihdr.push_back(0); // no interlace
+    put_chunk(out, "IHDR", ihdr);
+    put_chunk(out, "IDAT", zlib);
+    put_chunk(out, "IEND", std::vector<uint8_t>());
+
+    return write_file(path, &out[0], out.size(), NULL, 0);
+}
+
+bool write_raw_bytes(const std::string &path, const void *data, size_t size) {
+    return write_file(path, data, size, NULL, 0);
+}
+
+bool write_raw_floats(const std::string &path, const float *values, size_t count) {
+    return write_file(path, values, count * sizeof(float), NULL, 0);
+}
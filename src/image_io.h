@@ -0,0 +1,28 @@
+#ifndef IMAGE_IO_H
+#define IMAGE_IO_H
+
+#include <stdint.h>
+#include <string>
+
+// writers for the image formats we bake and capture. rows are stored top to
+// bottom, samples are interleaved and 16-bit samples are native endian in
+// memory (the writers take care of the byte order of the file)
+
+// binary PGM (P5), 8 or 16 bits per sample, single channel
+bool write_pgm(const std::string &path, int width, int height, int bits, const void *pixels);
+
+// binary PPM (P6), 8-bit RGB
+bool write_ppm(const std::string &path, int width, int height, const uint8_t *pixels);
+
+// PNG with 1 (gray), 3 (RGB) or 4 (RGBA) channels of 8 or 16 bits. the data
+// is stored without compression, which keeps this dependency free and fast
+// to write, at the cost of file size
+bool write_png(const std::string &path, int width, int height, int channels, int bits, const void *pixels);
+
+// raw bytes, no header
+bool write_raw_bytes(const std::string &path, const void *data, size_t size);
+
+// raw native endian 32-bit floats, no header
+bool write_raw_floats(const std::string &path, const float *values, size_t count);
+
+#endif // IMAGE_IO_H
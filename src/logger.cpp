@@ -0,0 +1,213 @@
+#include "logger.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+// bounded multi-producer queue after Dmitry Vyukov's design: every slot
+// carries a sequence number telling producers and the consumer whose turn
+// it is, so producers only contend on a single atomic increment
+class LogQueue {
+    private:
+        struct Slot {
+            std::atomic<size_t> sequence;
+            size_t length;
+            char text[LOG_RECORD_SIZE];
+        };
+
+        Slot slots[LOG_QUEUE_SIZE];
+        std::atomic<size_t> enqueue_pos;
+        size_t dequeue_pos;
+
+    public:
+        LogQueue(): enqueue_pos(0), dequeue_pos(0) {
+            for (size_t i=0; i<LOG_QUEUE_SIZE; i++) {
+                slots[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        // any thread, false when the queue is full
+        bool push(const char *text, size_t length) {
+            size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+            Slot *slot;
+            while (true) {
+                slot = &slots[pos % LOG_QUEUE_SIZE];
+                size_t sequence = slot->sequence.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+                if (diff == 0) {
+                    if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                        break;
+                    }
+                } else if (diff < 0) {
+                    return false;
+                } else {
+                    pos = enqueue_pos.load(std::memory_order_relaxed);
+                }
+            }
+            memcpy(slot->text, text, length);
+            slot->length = length;
+            slot->sequence.store(pos + 1, std::memory_order_release);
+            return true;
+        }
+
+        // the writer thread only, copies the oldest record out, false if empty
+        bool pop(char *text, size_t &length) {
+            Slot *slot = &slots[dequeue_pos % LOG_QUEUE_SIZE];
+            size_t sequence = slot->sequence.load(std::memory_order_acquire);
+            if ((intptr_t)sequence - (intptr_t)(dequeue_pos + 1) < 0) {
+                return false;
+            }
+            length = slot->length;
+            memcpy(text, slot->text, length);
+            slot->sequence.store(dequeue_pos + LOG_QUEUE_SIZE, std::memory_order_release);
+            dequeue_pos++;
+            return true;
+        }
+
+        // records pushed so far, written or not
+        size_t pushed() { return enqueue_pos.load(std::memory_order_acquire); }
+
+        // the writer thread only, whether the oldest record has been published
+        bool pending() {
+            Slot *slot = &slots[dequeue_pos % LOG_QUEUE_SIZE];
+            size_t sequence = slot->sequence.load();
+            return (intptr_t)sequence - (intptr_t)(dequeue_pos + 1) >= 0;
+        }
+};
+
+// owns the writer thread, started with the first record and joined when the
+// program exits
+class Logger {
+    private:
+        LogQueue queue;
+        std::thread writer;
+        std::once_flag started;
+        std::atomic<bool> stopping;
+        std::atomic<size_t> written;
+        std::atomic<size_t> dropped;
+
+        // the writer sleeps on wakeup once the queue is empty, announcing it
+        // in parked so producers only take the mutex to wake it when it does.
+        // flushers wait on progress, which the writer signals while any are
+        // waiting
+        std::mutex mutex;
+        std::condition_variable wakeup, progress;
+        std::atomic<bool> parked;
+        std::atomic<int> flushers;
+
+        // parked and flushers pair with the queue and written the way
+        // Dekker's algorithm does: each side stores its own flag before
+        // reading the other's, sequentially consistent so one of them is
+        // sure to see the other
+        bool has_work() {
+            return queue.pending() || stopping.load();
+        }
+
+        void run() {
+            char text[LOG_RECORD_SIZE];
+            size_t length;
+            while (true) {
+                bool wrote = false;
+                while (queue.pop(text, length)) {
+                    fwrite(text, 1, length, stderr);
+                    written.fetch_add(1);
+                    wrote = true;
+                }
+                if (wrote) {
+                    size_t lost = dropped.exchange(0, std::memory_order_relaxed);
+                    if (lost > 0) {
+                        fprintf(stderr, "(%zu log records dropped, the queue was full)\n", lost);
+                    }
+                    fflush(stderr);
+                    if (flushers.load() > 0) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        progress.notify_all();
+                    }
+                } else if (stopping.load(std::memory_order_acquire)) {
+                    return;
+                } else {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    parked.store(true);
+                    wakeup.wait(lock, [this] { return has_work(); });
+                    parked.store(false);
+                }
+            }
+        }
+
+        void wake_writer() {
+            // the record was published with a release store, order it
+            // before reading parked
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (parked.load()) {
+                std::lock_guard<std::mutex> lock(mutex);
+                wakeup.notify_one();
+            }
+        }
+
+    public:
+        Logger(): stopping(false), written(0), dropped(0), parked(false), flushers(0) {}
+
+        ~Logger() {
+            stopping.store(true);
+            wake_writer();
+            if (writer.joinable()) {
+                writer.join();
+            }
+        }
+
+        void push(const char *text, size_t length) {
+            if (stopping.load(std::memory_order_acquire)) {
+                // logged during shutdown, there is nobody left to hand it to
+                fwrite(text, 1, length, stderr);
+                return;
+            }
+            std::call_once(started, [this] { writer = std::thread(&Logger::run, this); });
+            if (!queue.push(text, length)) {
+                dropped.fetch_add(1, std::memory_order_relaxed);
+                return;
+            }
+            // lock-free unless the writer is asleep
+            wake_writer();
+        }
+
+        void flush() {
+            // dropped records never got a place in the queue, so they don't count here
+            size_t target = queue.pushed();
+            if (!writer.joinable()) {
+                return;
+            }
+            std::unique_lock<std::mutex> lock(mutex);
+            flushers.fetch_add(1);
+            progress.wait(lock, [&] { return written.load() >= target; });
+            flushers.fetch_sub(1);
+        }
+};
+
+static Logger logger;
+
+void log(const char *fmt, ...) {
+    static thread_local char buffer[LOG_RECORD_SIZE];
+
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buffer, sizeof(buffer), fmt, ap);
+    va_end(ap);
+    if (n < 0) {
+        return;
+    }
+
+    size_t length = n;
+    if (length >= sizeof(buffer)) {
+        // mark the truncation, keeping the line break of the original
+        length = sizeof(buffer) - 1;
+        memcpy(&buffer[length - 4], "...\n", 4);
+    }
+    logger.push(buffer, length);
+}
+
+void log_flush() {
+    logger.flush();
+}
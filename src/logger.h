@@ -0,0 +1,21 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+// longest record, longer messages are truncated
+#define LOG_RECORD_SIZE 512
+// records waiting to be written before new ones are dropped
+#define LOG_QUEUE_SIZE 1024
+
+// log a formatted string to stderr. the message is formatted on the calling
+// thread into a thread local buffer and handed to a background writer
+// through a lock-free queue, so it never allocates or blocks on the stream
+void log(const char *fmt, ...)
+#if defined(__GNUC__) || defined(__clang__)
+    __attribute__((format(printf, 1, 2)))
+#endif
+    ;
+
+// wait until every record logged so far has been written
+void log_flush();
+
+#endif // LOGGER_H
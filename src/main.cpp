@@ -2,10 +2,28 @@
 #include <GLUT/glut.h>
 #include <Eigen/Core>
 
+#include <algorithm>
+#include <chrono>
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <vector>
 
 #include "app.h"
+#include "camera_path.h"
+#include "gl_ext.h"
+#include "gpu_timer.h"
+#include "gl_state.h"
+#include "frame_pacer.h"
+#include "fixed_timestep.h"
+#include "frame_capture.h"
+#include "image_io.h"
+#include "ocean_fft.h"
+#include "offscreen.h"
+#include "options.h"
+#include "profiler.h"
+#include "rolling_stats.h"
+#include "trace.h"
 
 const int WINDOW_WIDTH = 800;
 const int WINDOW_HEIGHT = 600;
@@ -13,14 +31,19 @@ const int WINDOW_HEIGHT = 600;
 const int GENERATED_WIDTH = 5;
 const int GENERATED_HEIGHT = 5;
 
-const float FRAMERATE = 60;
-
 #define PI 3.14159265359
 
 App application(GENERATED_WIDTH, GENERATED_HEIGHT);
+Options options;
+GpuTimer gpu_timer;
+FramePacer pacer;
+FrameCapture capture;
+
+// aspect ratio the projection was last built for
+float projection_ratio = 0.0f;
 
 void error_callback(int error, const char *description) {
-    fputs(description, stderr);
+    log("glfw error %d: %s\n", error, description);
 }
 
 // lots of reference was drawn from https://github.com/rodrigosetti/azteroids/
@@ -31,6 +54,13 @@ static void key_callback (GLFWwindow* window, int key, int scancode, int action,
         return;
     }
 
+    // snapshot the trace so far without stopping it
+    if (key == GLFW_KEY_F12 && action == GLFW_PRESS && trace.is_recording()) {
+        profiler.collect(TraceRecorder::sink);
+        trace.write(options.trace_file);
+        return;
+    }
+
     // set keys
     if (action == GLFW_PRESS || action == GLFW_RELEASE) {
         bool key_pressed = action == GLFW_PRESS;
@@ -51,10 +81,20 @@ static void key_callback (GLFWwindow* window, int key, int scancode, int action,
                 application.keys_pressed.space = key_pressed;
                 break;
             case GLFW_KEY_M:
-                glPolygonMode( GL_FRONT_AND_BACK, GL_LINE );
+                gl_state.polygon_mode(GL_LINE);
                 break;
             case GLFW_KEY_N:
-                glPolygonMode( GL_FRONT_AND_BACK, GL_FILL );
+                gl_state.polygon_mode(GL_FILL);
+                break;
+            case GLFW_KEY_G:
+                if (key_pressed) {
+                    application.toggle_gpu_mesh();
+                }
+                break;
+            case GLFW_KEY_T:
+                if (key_pressed) {
+                    application.toggle_tessellation();
+                }
                 break;
         }
     }
@@ -67,9 +107,227 @@ static void key_callback (GLFWwindow* window, int key, int scancode, int action,
 
 }
 
+// clear and draw the application's interpolated state into the current framebuffer
+static void render_frame(int width, int height) {
+    float ratio = width / (float) height;
+
+    gl_state.viewport(0, 0, width, height);
+    gpu_timer.begin_pass("clear");
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    gpu_timer.end_pass();
+
+    // the projection only depends on the framebuffer shape
+    if (ratio != projection_ratio) {
+        glMatrixMode( GL_PROJECTION );
+        glLoadIdentity();
+        glOrtho(-ratio, ratio, -1.5, 1.5, 10, -10);
+        projection_ratio = ratio;
+    }
+
+    glMatrixMode(GL_MODELVIEW);
+    glLoadIdentity();
+    const CameraPose &camera = application.camera;
+    // zoom in screen space, so it never pushes the terrain past the depth range
+    glScalef(camera.zoom, camera.zoom, 1.0f);
+    glTranslatef(camera.position[0], camera.position[1], camera.position[2]);
+    glRotatef(camera.pitch, 1.0f, 0.0f, 0.0f);
+    glRotatef(camera.roll, 0.0f, 0.0f, -1.0f);
+
+    {
+        GpuPassScope pass(gpu_timer, "draw");
+        application.draw();
+    }
+}
+
+// reports printed and files written once the run is over, the context must
+// still be current for the frames captured last
+static void final_reports() {
+    capture.finish();
+    capture.report(stderr);
+    if (options.frame_stats)
+        pacer.report(stderr);
+    profiler.collect(TraceRecorder::sink);
+    if (options.profile)
+        profiler.report(stderr);
+    if (trace.is_recording())
+        trace.write(options.trace_file);
+    if (options.gl_state_stats)
+        gl_state.report(stderr);
+
+    if (gpu_timer.is_enabled()) {
+        FILE *file = options.gpu_timing_file.empty() ? NULL : fopen(options.gpu_timing_file.c_str(), "w");
+        gpu_timer.report(file ? file : stderr);
+        if (file)
+            fclose(file);
+    }
+}
+
+// the waves of --waves and the ocean of --ocean or --ocean-loop, false if the
+// bank or loop can't be loaded
+static bool setup_surface() {
+    if (!options.waves_file.empty()) {
+        GerstnerBank bank;
+        if (!bank.load(options.waves_file)) {
+            log("could not load a wave bank from %s\n", options.waves_file.c_str());
+            return false;
+        }
+        application.set_waves(bank);
+        log("loaded %d waves from %s\n", bank.get_count(), options.waves_file.c_str());
+    }
+    if (options.ocean_size)
+        application.setup_ocean(options.ocean_size);
+    if (!options.ocean_loop_file.empty() && !application.setup_ocean_loop(options.ocean_loop_file)) {
+        log("could not open an ocean loop from %s\n", options.ocean_loop_file.c_str());
+        return false;
+    }
+    return true;
+}
+
+// the path named by --replay, either built in or a recorded file
+static bool load_replay(CameraPath &path) {
+    if (path.generate(options.replay, options.replay_steps, 1.0 / options.sim_rate))
+        return true;
+    if (path.load(options.replay))
+        return true;
+    log("%s is neither a camera path file nor orbit, flyover or zoom\n", options.replay.c_str());
+    return false;
+}
+
+// summary of the frame times of a replay, each also written to --frame-times
+// so distributions can be compared across builds
+static void report_frame_times(const std::vector<double> &times) {
+    RollingStats stats(std::max<size_t>(times.size(), 1));
+    for (size_t i=0; i<times.size(); i++)
+        stats.add(times[i]);
+    StatsSummary frame = stats.summarize();
+    fprintf(stderr, "frame ms min %.3f avg %.3f p50 %.3f p99 %.3f max %.3f\n",
+            frame.min*1e3, frame.avg*1e3, frame.p50*1e3, frame.p99*1e3, frame.max*1e3);
+
+    if (options.frame_times_file.empty())
+        return;
+    FILE *file = fopen(options.frame_times_file.c_str(), "w");
+    if (!file) {
+        log("could not write %s\n", options.frame_times_file.c_str());
+        return;
+    }
+    for (size_t i=0; i<times.size(); i++)
+        fprintf(file, "%.4f\n", times[i]*1e3);
+    fclose(file);
+}
+
+// compare the compute shader noise against the CPU
+static bool verify_gpu_noise() {
+    PNoise noise;
+    noise.set_amplitude(2.0f);
+    return verify_noise_compute(noise, 1e-4f, 1e-3f);
+}
+
+// render frames without a window along a camera path (--replay, by default an
+// orbit of --offscreen frames) and report how long they took. every frame
+// advances exactly one simulation step, so runs are reproducible however fast
+// the machine is
+static int run_offscreen() {
+    OffscreenContext context;
+    if (!context.create(options.offscreen_width, options.offscreen_height))
+        return EXIT_FAILURE;
+
+    load_gl_extensions(OffscreenContext::get_proc_address);
+
+    if (options.verify_gpu_noise)
+        return verify_gpu_noise() ? EXIT_SUCCESS : EXIT_FAILURE;
+
+    application.initialize();
+    application.setup_shaders();
+    if (!setup_surface())
+        return EXIT_FAILURE;
+
+    if (options.gpu_timing)
+        gpu_timer.setup();
+    if (!options.capture_pattern.empty() && !capture.start(options.capture_pattern, options.capture_frames))
+        return EXIT_FAILURE;
+
+    CameraPath path;
+    if (options.replay.empty()) {
+        path.generate("orbit", std::max(options.offscreen_frames, 1), 1.0 / options.sim_rate);
+    } else if (!load_replay(path)) {
+        return EXIT_FAILURE;
+    }
+
+    int frames = options.replay.empty() ? options.offscreen_frames : path.get_length();
+    std::vector<double> frame_times;
+    frame_times.reserve(frames);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (int i=0; i<frames; i++) {
+        std::chrono::steady_clock::time_point frame_start = std::chrono::steady_clock::now();
+        {
+            PROFILE_ZONE("frame");
+            gpu_timer.begin_frame();
+
+            {
+                PROFILE_ZONE("update");
+                application.update(path.get_step());
+                application.set_camera(path.get(i));
+                application.interpolate(1.0);
+            }
+
+            render_frame(context.get_width(), context.get_height());
+            capture.capture(context.get_width(), context.get_height());
+
+            // nothing is presented, so wait for the GPU to get the whole frame's time
+            {
+                PROFILE_ZONE("finish");
+                glFinish();
+            }
+            gpu_timer.end_frame();
+            gl_state.end_frame();
+        }
+        frame_times.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - frame_start).count());
+        profiler.collect(TraceRecorder::sink);
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    fprintf(stderr, "offscreen: %d frames at %dx%d in %.3f s (%.1f fps)\n",
+            frames, context.get_width(), context.get_height(), seconds, frames / seconds);
+    report_frame_times(frame_times);
+
+    bool ok = true;
+    if (!options.dump_file.empty()) {
+        int width = context.get_width(), height = context.get_height();
+        std::vector<unsigned char> pixels((size_t)width * height * 3);
+        context.read_pixels(&pixels[0]);
+
+        size_t length = options.dump_file.size();
+        if (length > 4 && options.dump_file.compare(length - 4, 4, ".png") == 0) {
+            ok = write_png(options.dump_file, width, height, 3, 8, &pixels[0]);
+        } else {
+            ok = write_ppm(options.dump_file, width, height, &pixels[0]);
+        }
+        log(ok ? "wrote %s\n" : "could not write %s\n", options.dump_file.c_str());
+    }
+
+    final_reports();
+    return ok ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
 int main(int argc, char **argv) {
     GLFWwindow* window;
-    double prevTime = 0.0;
+
+    if (!parse_options(argc, argv, options))
+        exit(EXIT_FAILURE);
+
+    // the ocean check needs no GL context
+    if (options.verify_ocean)
+        exit(verify_ocean_fft() ? EXIT_SUCCESS : EXIT_FAILURE);
+
+    profiler.set_enabled(options.profile);
+    profiler.set_thread_name("main");
+    if (!options.trace_file.empty())
+        trace.start();
+
+    // no window, no GLFW
+    if (options.offscreen)
+        exit(run_offscreen());
 
     // MUST happen before glfwInit
     glfwSetErrorCallback(error_callback);
@@ -89,46 +347,124 @@ int main(int argc, char **argv) {
     glfwMakeContextCurrent(window);
     glfwSetKeyCallback(window, key_callback);
 
+    load_gl_extensions(glfwGetProcAddress);
+
+    // compare the compute shader noise against the CPU and quit
+    if (options.verify_gpu_noise) {
+        bool ok = verify_gpu_noise();
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        exit(ok ? EXIT_SUCCESS : EXIT_FAILURE);
+    }
+
     application.initialize();
 
     application.setup_shaders();
+    if (!setup_surface()) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        exit(EXIT_FAILURE);
+    }
+
+    if (options.gpu_timing)
+        gpu_timer.setup();
+    if (!options.capture_pattern.empty() && !capture.start(options.capture_pattern, options.capture_frames)) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        exit(EXIT_FAILURE);
+    }
+    double last_report = glfwGetTime();
+
+    const GLFWvidmode *mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+    pacer.setup(options.frame_rate, options.vsync, mode ? mode->refreshRate : 0);
+    FixedTimestep timestep(options.sim_rate, options.max_sim_steps);
+
+    // replays drive the camera one recorded step per frame, ignoring input
+    CameraPath replay_path;
+    int replay_frame = 0;
+    std::vector<double> frame_times;
+    if (!options.replay.empty() && !load_replay(replay_path)) {
+        glfwDestroyWindow(window);
+        glfwTerminate();
+        exit(EXIT_FAILURE);
+    }
+    CameraPath recording(replay_path.get_length() > 0 ? replay_path.get_step() : timestep.get_step());
 
     while (!glfwWindowShouldClose(window))
     {
-        // run until user clicks exit on window
+        // run until user clicks exit on window, sleeping off the rest of the frame
+        double delta = pacer.wait();
+        double time = glfwGetTime();
+        PROFILE_ZONE("frame");
+
         int width, height;
         glfwGetFramebufferSize(window, &width, &height);
-        float ratio = width / (float) height;
 
-        glViewport(0, 0, width, height);
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        gpu_timer.begin_frame();
 
-        glMatrixMode( GL_PROJECTION );
-        glLoadIdentity();
-        glOrtho(-ratio, ratio, -1.5, 1.5, 10, -10);
+        // simulate in fixed steps, then render in between the last two
+        if (replay_path.get_length() > 0) {
+            PROFILE_ZONE("update");
+            // the first frame's time includes startup
+            if (replay_frame > 0)
+                frame_times.push_back(delta);
+            application.update(replay_path.get_step());
+            application.set_camera(replay_path.get(replay_frame));
+            application.interpolate(1.0);
+            if (!options.record_file.empty())
+                recording.add(application.get_camera());
+            if (++replay_frame == replay_path.get_length())
+                glfwSetWindowShouldClose(window, GL_TRUE);
+        } else {
+            PROFILE_ZONE("update");
+            int steps = timestep.advance(delta);
+            for (int i=0; i<steps; i++) {
+                application.update(timestep.get_step());
+                if (!options.record_file.empty())
+                    recording.add(application.get_camera());
+            }
+            application.interpolate(timestep.get_alpha());
+        }
 
-        glMatrixMode(GL_MODELVIEW);
-        glLoadIdentity();
-        Eigen::Vector3f pos = application.camera_position;
-        glTranslatef(pos[0], pos[1], pos[2]);
-        glRotatef(application.camera_pitch, 1.0f, 0.0f, 0.0f);
-        glRotatef(application.camera_roll, 0.0f, 0.0f, -1.0f);
-
-        // get the time difference between the last time we ran the loop
-        double delta = 0.0;
-        double time;
-        while (delta < 1.0f/FRAMERATE) {
-            time = glfwGetTime();
-            delta = time - prevTime;
+        render_frame(width, height);
+        capture.capture(width, height);
+
+        // the swap pass covers whatever the driver does to present the frame
+        {
+            PROFILE_ZONE("swap");
+            gpu_timer.begin_pass("swap");
+            glfwSwapBuffers(window);
+            gpu_timer.end_pass();
         }
-        prevTime = time;
+        gpu_timer.end_frame();
+        gl_state.end_frame();
 
+        if (time - last_report >= options.report_interval) {
+            if (options.frame_stats)
+                pacer.report(stderr);
+            gpu_timer.report(stderr);
+            if (options.profile)
+                profiler.report(stderr);
+            last_report = time;
+        }
 
-        application.update(delta);
-        application.draw();
+        {
+            PROFILE_ZONE("poll_events");
+            glfwPollEvents();
+        }
+        // the frame zone is still open, it is collected with the next frame
+        profiler.collect(TraceRecorder::sink);
+    }
+
+    if (replay_path.get_length() > 0)
+        report_frame_times(frame_times);
+    final_reports();
 
-        glfwSwapBuffers(window);
-        glfwPollEvents();
+    if (!options.record_file.empty()) {
+        if (recording.save(options.record_file))
+            log("recorded %d camera steps to %s\n", recording.get_length(), options.record_file.c_str());
+        else
+            log("could not write %s\n", options.record_file.c_str());
     }
 
     glfwDestroyWindow(window);
@@ -0,0 +1,67 @@
+#include "mapped_file.h"
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+bool MappedFile::open(const std::string &path) {
+    close();
+
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    if (fstat(fd, &info) == 0 && info.st_size > 0) {
+        void *view = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (view != MAP_FAILED) {
+            data = (const char *)view;
+            size = info.st_size;
+            mapped = true;
+        }
+    }
+    // the mapping keeps its own reference to the file
+    ::close(fd);
+    if (mapped) {
+        return true;
+    }
+#endif
+
+    FILE *file = fopen(path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+    fseek(file, 0, SEEK_END);
+    long length = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    bool ok = length > 0;
+    if (ok) {
+        buffer.resize(length);
+        ok = fread(&buffer[0], 1, length, file) == (size_t)length;
+    }
+    fclose(file);
+    if (!ok) {
+        buffer.clear();
+        return false;
+    }
+    data = &buffer[0];
+    size = buffer.size();
+    return true;
+}
+
+void MappedFile::close() {
+#ifndef _WIN32
+    if (mapped) {
+        munmap((void *)data, size);
+    }
+#endif
+    std::vector<char>().swap(buffer);
+    data = NULL;
+    size = 0;
+    mapped = false;
+}
@@ -0,0 +1,35 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+
+// a whole file opened read only. on POSIX systems it is memory mapped, so
+// pages are only read from disk once touched and stay shared between
+// processes through the page cache. elsewhere the file is read in
+class MappedFile {
+    private:
+        const char *data = NULL;
+        size_t size = 0;
+        bool mapped = false;
+        // the contents when the file couldn't be mapped
+        std::vector<char> buffer;
+
+    public:
+        MappedFile() {}
+        ~MappedFile() { close(); }
+
+        // non-copyable, the mapping is owned
+        MappedFile(const MappedFile &) = delete;
+        MappedFile &operator=(const MappedFile &) = delete;
+
+        // false if the file can't be opened or is empty
+        bool open(const std::string &path);
+        void close();
+
+        const char *get_data() { return data; }
+        size_t get_size() { return size; }
+};
+
+#endif // MAPPED_FILE_H
@@ -0,0 +1,130 @@
+#include "noise_compute.h"
+#include "logger.h"
+#include "gl_state.h"
+#include <math.h>
+#include <algorithm>
+
+// must match local_size in noise.comp
+#define GROUP_SIZE 8
+
+// std430 layout of a vertex in the compute output
+struct DeviceVertex {
+    float position[4];
+    float normal[4];
+};
+
+bool NoiseCompute::setup() {
+    if (!glext.compute) {
+        log("compute shaders need OpenGL 4.3, noise stays on the CPU\n");
+        return false;
+    }
+
+    program.add_stage(GL_COMPUTE_SHADER, "src/noise.comp");
+    if (!program.build(SHADER_CACHE_DIR)) {
+        return false;
+    }
+
+    glGenBuffers(1, &vertex_buffer);
+    glGenBuffers(1, &index_buffer);
+    return true;
+}
+
+void NoiseCompute::generate(PNoise &noise, Heightfield &grid) {
+    if (grid.columns != columns || grid.rows != rows) {
+        columns = grid.columns;
+        rows = grid.rows;
+
+        gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer);
+        glBufferData(GL_ARRAY_BUFFER, columns*rows*sizeof(DeviceVertex), NULL, GL_DYNAMIC_COPY);
+
+        // the grid topology only changes with its size
+        std::vector<GLuint> indices;
+        indices.reserve((columns-1)*(rows-1)*4);
+        for(int j=0; j<rows-1; j++) {
+            for(int i=0; i<columns-1; i++) {
+                indices.push_back(grid.index(i, j));
+                indices.push_back(grid.index(i+1, j));
+                indices.push_back(grid.index(i+1, j+1));
+                indices.push_back(grid.index(i, j+1));
+            }
+        }
+        index_count = indices.size();
+        gl_state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size()*sizeof(GLuint), &indices[0], GL_STATIC_DRAW);
+    }
+
+    GLuint previous = gl_state.get_program();
+
+    program.use();
+    gl_state.uniform2i(program.uniform("grid_size"), columns, rows);
+    gl_state.uniform2f(program.uniform("origin"), grid.origin_x, grid.origin_y);
+    gl_state.uniform1f(program.uniform("spacing"), grid.spacing);
+    gl_state.uniform1f(program.uniform("amplitude"), noise.get_amplitude());
+    gl_state.uniform1f(program.uniform("wavelength"), noise.get_wavelength());
+    gl_state.uniform1i(program.uniform("seed"), (GLint)noise.get_seed());
+
+    gl_state.bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 0, vertex_buffer);
+    glext.DispatchCompute((columns + GROUP_SIZE-1)/GROUP_SIZE, (rows + GROUP_SIZE-1)/GROUP_SIZE, 1);
+    gl_state.bind_buffer_base(GL_SHADER_STORAGE_BUFFER, 0, 0);
+
+    // the buffer is read as vertices or copied back next
+    glext.MemoryBarrierGL(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT | GL_BUFFER_UPDATE_BARRIER_BIT);
+
+    gl_state.use_program(previous);
+}
+
+void NoiseCompute::read_back(Heightfield &grid) {
+    std::vector<DeviceVertex> device(columns*rows);
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer);
+    glGetBufferSubData(GL_ARRAY_BUFFER, 0, device.size()*sizeof(DeviceVertex), &device[0]);
+
+    grid.heights.resize(device.size());
+    grid.normals.resize(device.size());
+    for(size_t i=0; i<device.size(); i++) {
+        grid.heights[i] = device[i].position[2];
+        grid.normals[i] = Eigen::Vector3f(device[i].normal[0], device[i].normal[1], device[i].normal[2]);
+    }
+}
+
+void NoiseCompute::draw() {
+    gl_state.bind_buffer(GL_ARRAY_BUFFER, vertex_buffer);
+    gl_state.bind_buffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+    glEnableClientState(GL_VERTEX_ARRAY);
+    glEnableClientState(GL_NORMAL_ARRAY);
+    glVertexPointer(3, GL_FLOAT, sizeof(DeviceVertex), (const GLvoid *)offsetof(DeviceVertex, position));
+    glNormalPointer(GL_FLOAT, sizeof(DeviceVertex), (const GLvoid *)offsetof(DeviceVertex, normal));
+
+    glDrawElements(GL_QUADS, index_count, GL_UNSIGNED_INT, 0);
+
+    glDisableClientState(GL_NORMAL_ARRAY);
+    glDisableClientState(GL_VERTEX_ARRAY);
+}
+
+bool NoiseCompute::is_ready() {
+    return columns > 0;
+}
+
+bool verify_noise_compute(PNoise &noise, float height_tolerance, float normal_tolerance) {
+    NoiseCompute compute;
+    if (!compute.setup()) {
+        return false;
+    }
+
+    // an odd size that isn't a multiple of the group size, straddling the origin
+    Heightfield cpu(203, 157, -7.3f, -4.1f, 0.07f);
+    Heightfield gpu = cpu;
+    cpu.generate(noise);
+    compute.generate(noise, gpu);
+    compute.read_back(gpu);
+
+    float height_error = 0, normal_error = 0;
+    for(size_t i=0; i<cpu.heights.size(); i++) {
+        height_error = std::max(height_error, fabsf(cpu.heights[i] - gpu.heights[i]));
+        normal_error = std::max(normal_error, (cpu.normals[i] - gpu.normals[i]).cwiseAbs().maxCoeff());
+    }
+
+    bool ok = height_error <= height_tolerance && normal_error <= normal_tolerance;
+    log("gpu noise %s: max height error %g (tolerance %g), max normal error %g (tolerance %g)\n",
+            ok ? "matches" : "DIFFERS", height_error, height_tolerance, normal_error, normal_tolerance);
+    return ok;
+}
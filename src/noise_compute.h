@@ -0,0 +1,41 @@
+#ifndef NOISE_COMPUTE_H
+#define NOISE_COMPUTE_H
+
+#include "heightfield.h"
+#include "shader_program.h"
+
+// generates a Heightfield on the GPU with the noise compute shader. the
+// result stays on the device as an interleaved vertex buffer of
+// { vec4 position; vec4 normal; } ready to be drawn with an index buffer
+class NoiseCompute {
+    private:
+        ShaderProgram program;
+        GLuint vertex_buffer = 0;
+        GLuint index_buffer = 0;
+        GLsizei index_count = 0;
+        int columns = 0, rows = 0;
+
+    public:
+        NoiseCompute() {}
+
+        // compile the compute shader, false if the context can't run it
+        bool setup();
+
+        // evaluate the noise over the grid described by `grid` (its sizes and
+        // spacing, the contents aren't read) into the device buffers
+        void generate(PNoise &noise, Heightfield &grid);
+
+        // copy the device results back into grid
+        void read_back(Heightfield &grid);
+
+        // draw the generated grid as quads with the current program
+        void draw();
+
+        bool is_ready();
+};
+
+// generate the same grid on the CPU and with the compute shader and compare
+// them, logs the largest differences and returns true if within tolerance
+bool verify_noise_compute(PNoise &noise, float height_tolerance, float normal_tolerance);
+
+#endif // NOISE_COMPUTE_H
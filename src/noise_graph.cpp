@@ -0,0 +1,555 @@
+#include "noise_graph.h"
+#include "logger.h"
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <math.h>
+#include <sstream>
+#include <stdlib.h>
+
+int NoiseGraph::add_node(NoiseOp op, int a, int b, int c, float value, float value2) {
+    NoiseNode node;
+    node.op = op;
+    node.inputs[0] = a;
+    node.inputs[1] = b;
+    node.inputs[2] = c;
+    node.value = value;
+    node.value2 = value2;
+    nodes.push_back(node);
+    return nodes.size() - 1;
+}
+
+int NoiseGraph::noise(int x, int y, const PNoise &noise) {
+    int node = add_node(NOISE_OP_NOISE, x, y);
+    nodes[node].noise = noise;
+    return node;
+}
+
+int NoiseGraph::worley(int x, int y, const WorleyNoise &noise) {
+    int node = add_node(NOISE_OP_WORLEY, x, y);
+    nodes[node].cells = noise;
+    return node;
+}
+
+int NoiseGraph::fbm(int x, int y, const PNoise &noise, int octaves, float lacunarity, float gain) {
+    int node = add_node(NOISE_OP_FBM, x, y);
+    nodes[node].noise = noise;
+    nodes[node].octaves = std::max(octaves, 1);
+    nodes[node].lacunarity = lacunarity;
+    nodes[node].gain = gain;
+    return node;
+}
+
+int NoiseGraph::ridged(int x, int y, const PNoise &noise, int octaves, float lacunarity, float gain) {
+    int node = fbm(x, y, noise, octaves, lacunarity, gain);
+    nodes[node].op = NOISE_OP_RIDGED;
+    return node;
+}
+
+bool NoiseGraph::load(const std::string &path) {
+    std::ifstream file(path.c_str());
+    if (!file) {
+        return false;
+    }
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    return parse(buffer.str());
+}
+
+// the operand counts of the text ops, before the optional ones
+struct NoiseSyntax {
+    const char *name;
+    NoiseOp op;
+    int operands, optional;
+};
+
+static const NoiseSyntax NOISE_SYNTAX[] = {
+    { "noise", NOISE_OP_NOISE, 4, 1 },
+    { "fbm", NOISE_OP_FBM, 5, 1 },
+    { "ridged", NOISE_OP_RIDGED, 5, 1 },
+    { "worley", NOISE_OP_WORLEY, 5, 1 },
+    { "add", NOISE_OP_ADD, 2, 0 },
+    { "sub", NOISE_OP_SUBTRACT, 2, 0 },
+    { "mul", NOISE_OP_MULTIPLY, 2, 0 },
+    { "min", NOISE_OP_MINIMUM, 2, 0 },
+    { "max", NOISE_OP_MAXIMUM, 2, 0 },
+    { "abs", NOISE_OP_ABSOLUTE, 1, 0 },
+    { "mix", NOISE_OP_MIX, 3, 0 },
+    { "clamp", NOISE_OP_CLAMP, 3, 0 },
+    { "smoothstep", NOISE_OP_SMOOTHSTEP, 3, 0 },
+};
+
+static bool parse_number(const std::string &token, float &value) {
+    char *end;
+    value = strtof(token.c_str(), &end);
+    return !token.empty() && *end == 0;
+}
+
+bool NoiseGraph::parse(const std::string &text) {
+    NoiseGraph graph;
+    std::map<std::string, int> names;
+    names["x"] = graph.x();
+    names["y"] = graph.y();
+
+    std::istringstream lines(text);
+    std::string line;
+    int line_number = 0;
+    while (std::getline(lines, line)) {
+        line_number++;
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::vector<std::string> tokens;
+        std::string token;
+        while (words >> token) {
+            tokens.push_back(token);
+        }
+        if (tokens.empty()) {
+            continue;
+        }
+
+        // a node or number operand, numbers become constants
+        std::string error;
+        auto operand = [&](const std::string &token) {
+            float value;
+            if (names.count(token)) {
+                return names[token];
+            }
+            if (parse_number(token, value)) {
+                return graph.constant(value);
+            }
+            error = "unknown name " + token;
+            return -1;
+        };
+
+        if (tokens[0] == "output" && tokens.size() == 2) {
+            graph.output = operand(tokens[1]);
+        } else if (tokens.size() >= 3 && tokens[1] == "=") {
+            const NoiseSyntax *syntax = NULL;
+            for (const NoiseSyntax &candidate : NOISE_SYNTAX) {
+                if (tokens[2] == candidate.name) {
+                    syntax = &candidate;
+                }
+            }
+            int count = tokens.size() - 3;
+            if (!syntax) {
+                error = "unknown op " + tokens[2];
+            } else if (count < syntax->operands || count > syntax->operands + syntax->optional) {
+                error = "wrong number of operands to " + tokens[2];
+            } else if (syntax->op == NOISE_OP_NOISE || syntax->op == NOISE_OP_FBM || syntax->op == NOISE_OP_RIDGED) {
+                // the seed, wavelength, octaves and amplitude are numbers
+                float numbers[3] = { 0, 0, 1 };
+                PNoise noise;
+                bool ok = true;
+                for (int i=2; i<std::min(count, 5); i++) {
+                    ok &= parse_number(tokens[3 + i], numbers[i - 2]);
+                }
+                int x = operand(tokens[3]), y = operand(tokens[4]);
+                noise.set_seed((uint32_t)numbers[0]);
+                noise.set_wavelength(numbers[1]);
+                if (syntax->op == NOISE_OP_NOISE) {
+                    noise.set_amplitude(count > 4 ? numbers[2] : 1.0f);
+                    names[tokens[0]] = graph.noise(x, y, noise);
+                } else {
+                    float amplitude = 1.0f;
+                    ok &= count < 6 || parse_number(tokens[8], amplitude);
+                    noise.set_amplitude(amplitude);
+                    names[tokens[0]] = syntax->op == NOISE_OP_FBM
+                        ? graph.fbm(x, y, noise, (int)numbers[2])
+                        : graph.ridged(x, y, noise, (int)numbers[2]);
+                }
+                if (!ok || numbers[1] <= 0) {
+                    error = "bad noise parameters";
+                }
+            } else if (syntax->op == NOISE_OP_WORLEY) {
+                float seed, wavelength, amplitude = 1.0f;
+                WorleyNoise noise;
+                const std::string &mode = tokens[7];
+                if (!parse_number(tokens[5], seed) || !parse_number(tokens[6], wavelength) || wavelength <= 0
+                        || (count > 5 && !parse_number(tokens[8], amplitude))
+                        || (mode != "f1" && mode != "f2" && mode != "f2-f1")) {
+                    error = "bad worley parameters";
+                } else {
+                    noise.set_seed((uint32_t)seed);
+                    noise.set_wavelength(wavelength);
+                    noise.set_amplitude(amplitude);
+                    noise.set_mode(mode == "f1" ? WORLEY_F1 : mode == "f2" ? WORLEY_F2 : WORLEY_F2_MINUS_F1);
+                    names[tokens[0]] = graph.worley(operand(tokens[3]), operand(tokens[4]), noise);
+                }
+            } else if (syntax->op == NOISE_OP_CLAMP || syntax->op == NOISE_OP_SMOOTHSTEP) {
+                float low, high;
+                if (!parse_number(tokens[4], low) || !parse_number(tokens[5], high)) {
+                    error = "bad range";
+                } else {
+                    names[tokens[0]] = graph.add_node(syntax->op, operand(tokens[3]), -1, -1, low, high);
+                }
+            } else {
+                int inputs[3] = { -1, -1, -1 };
+                for (int i=0; i<count; i++) {
+                    inputs[i] = operand(tokens[3 + i]);
+                }
+                names[tokens[0]] = graph.add_node(syntax->op, inputs[0], inputs[1], inputs[2]);
+            }
+        } else {
+            error = "expected name = op operands or output name";
+        }
+
+        if (!error.empty()) {
+            log("noise graph line %d: %s\n", line_number, error.c_str());
+            return false;
+        }
+    }
+
+    if (graph.output < 0) {
+        log("noise graph has no output\n");
+        return false;
+    }
+    *this = graph;
+    return true;
+}
+
+// the scalar value of an arithmetic op, for folding constants
+static float fold(NoiseOp op, float a, float b, float c, float value, float value2) {
+    switch (op) {
+        case NOISE_OP_ADD: return a + b;
+        case NOISE_OP_SUBTRACT: return a - b;
+        case NOISE_OP_MULTIPLY: return a*b;
+        case NOISE_OP_MINIMUM: return std::min(a, b);
+        case NOISE_OP_MAXIMUM: return std::max(a, b);
+        case NOISE_OP_ABSOLUTE: return fabsf(a);
+        case NOISE_OP_MIX: return a + (b - a)*c;
+        case NOISE_OP_CLAMP: return std::min(std::max(a, value), value2);
+        case NOISE_OP_SMOOTHSTEP: {
+            float t = std::min(std::max((a - value) / (value2 - value), 0.0f), 1.0f);
+            return t*t*(3 - 2*t);
+        }
+        default: return 0;
+    }
+}
+
+static bool is_arithmetic(NoiseOp op) {
+    return op >= NOISE_OP_ADD && op <= NOISE_OP_SMOOTHSTEP;
+}
+
+static int input_count(const NoiseNode &node) {
+    int count = 0;
+    while (count < 3 && node.inputs[count] >= 0) {
+        count++;
+    }
+    return count;
+}
+
+bool NoiseProgram::compile(const NoiseGraph &graph) {
+    instructions.clear();
+    register_count = 0;
+    result = -1;
+    int output = graph.get_output();
+    if (output < 0) {
+        return false;
+    }
+
+    std::vector<NoiseNode> nodes(graph.get_count());
+    for (int i=0; i<graph.get_count(); i++) {
+        nodes[i] = graph.get(i);
+    }
+
+    // fold constants, and multiplies and adds by a constant into a*value +
+    // value2, composing chains of them into one
+    for (size_t i=0; i<nodes.size(); i++) {
+        NoiseNode &node = nodes[i];
+        if (!is_arithmetic(node.op)) {
+            continue;
+        }
+        int count = input_count(node);
+        bool constant = true;
+        float values[3] = { 0, 0, 0 };
+        for (int k=0; k<count; k++) {
+            constant &= nodes[node.inputs[k]].op == NOISE_OP_CONSTANT;
+            values[k] = nodes[node.inputs[k]].value;
+        }
+        if (constant) {
+            node.value = fold(node.op, values[0], values[1], values[2], node.value, node.value2);
+            node.op = NOISE_OP_CONSTANT;
+            node.inputs[0] = node.inputs[1] = node.inputs[2] = -1;
+            continue;
+        }
+
+        if (node.op == NOISE_OP_ADD || node.op == NOISE_OP_SUBTRACT || node.op == NOISE_OP_MULTIPLY) {
+            bool first = nodes[node.inputs[0]].op == NOISE_OP_CONSTANT;
+            bool second = nodes[node.inputs[1]].op == NOISE_OP_CONSTANT;
+            if (first || second) {
+                float k = nodes[node.inputs[first ? 0 : 1]].value;
+                int a = node.inputs[first ? 1 : 0];
+                float scale = 1, offset = 0;
+                if (node.op == NOISE_OP_MULTIPLY) {
+                    scale = k;
+                } else if (node.op == NOISE_OP_ADD) {
+                    offset = k;
+                } else if (first) {
+                    // k - a
+                    scale = -1;
+                    offset = k;
+                } else {
+                    offset = -k;
+                }
+                if (nodes[a].op == NOISE_OP_AFFINE) {
+                    offset += nodes[a].value2*scale;
+                    scale *= nodes[a].value;
+                    a = nodes[a].inputs[0];
+                }
+                node.op = NOISE_OP_AFFINE;
+                node.inputs[0] = a;
+                node.inputs[1] = node.inputs[2] = -1;
+                node.value = scale;
+                node.value2 = offset;
+            }
+        }
+    }
+
+    // the nodes the output reads, and how many readers each has
+    std::vector<int> readers(nodes.size(), 0);
+    std::vector<bool> live(nodes.size(), false);
+    live[output] = true;
+    for (int i=output; i>=0; i--) {
+        if (!live[i]) {
+            continue;
+        }
+        for (int k=0; k<input_count(nodes[i]); k++) {
+            live[nodes[i].inputs[k]] = true;
+            readers[nodes[i].inputs[k]]++;
+        }
+    }
+
+    // a multiply only an add reads becomes part of the add
+    for (int i=0; i<=output; i++) {
+        NoiseNode &node = nodes[i];
+        if (!live[i] || node.op != NOISE_OP_ADD) {
+            continue;
+        }
+        for (int k=0; k<2; k++) {
+            int product = node.inputs[k];
+            if (nodes[product].op == NOISE_OP_MULTIPLY && readers[product] == 1) {
+                int other = node.inputs[1 - k];
+                node.op = NOISE_OP_MULTIPLY_ADD;
+                node.inputs[0] = nodes[product].inputs[0];
+                node.inputs[1] = nodes[product].inputs[1];
+                node.inputs[2] = other;
+                live[product] = false;
+                break;
+            }
+        }
+    }
+
+    // the last node reading each node, its register is free after that
+    std::vector<int> last_reader(nodes.size(), -1);
+    for (int i=0; i<=output; i++) {
+        if (live[i]) {
+            for (int k=0; k<input_count(nodes[i]); k++) {
+                last_reader[nodes[i].inputs[k]] = i;
+            }
+        }
+    }
+
+    std::vector<int> registers(nodes.size(), -1);
+    std::vector<int> free_registers;
+    for (int i=0; i<=output; i++) {
+        if (!live[i]) {
+            continue;
+        }
+        const NoiseNode &node = nodes[i];
+        // taken before the inputs are freed so no instruction writes a
+        // register it reads
+        int target;
+        if (free_registers.empty()) {
+            target = register_count++;
+        } else {
+            target = free_registers.back();
+            free_registers.pop_back();
+        }
+        registers[i] = target;
+
+        NoiseInstruction instruction;
+        instruction.op = node.op;
+        instruction.target = target;
+        int *operands[3] = { &instruction.a, &instruction.b, &instruction.c };
+        for (int k=0; k<3; k++) {
+            *operands[k] = node.inputs[k] >= 0 ? registers[node.inputs[k]] : -1;
+        }
+        instruction.value = node.value;
+        instruction.value2 = node.value2;
+        instruction.noise = node.noise;
+        instruction.cells = node.cells;
+
+        if (node.op == NOISE_OP_FBM || node.op == NOISE_OP_RIDGED) {
+            // an instruction per octave adding to the target
+            PNoise octave = node.noise;
+            float amplitude = octave.get_amplitude();
+            if (node.op == NOISE_OP_RIDGED) {
+                instruction.op = NOISE_OP_CONSTANT;
+                instruction.value = 0;
+                instructions.push_back(instruction);
+            }
+            for (int o=0; o<node.octaves; o++) {
+                instruction.op = node.op == NOISE_OP_RIDGED ? NOISE_OP_ADD_RIDGE
+                    : o == 0 ? NOISE_OP_NOISE : NOISE_OP_ADD_NOISE;
+                instruction.value = amplitude;
+                octave.set_amplitude(node.op == NOISE_OP_RIDGED ? 1.0f : amplitude);
+                instruction.noise = octave;
+                instructions.push_back(instruction);
+                octave.set_seed(octave.get_seed() + 1);
+                octave.set_wavelength(octave.get_wavelength() / node.lacunarity);
+                amplitude *= node.gain;
+            }
+        } else {
+            instructions.push_back(instruction);
+        }
+
+        for (int k=0; k<input_count(node); k++) {
+            int input = node.inputs[k];
+            // inputs read twice are freed once
+            bool repeated = k > 0 && std::find(node.inputs, node.inputs + k, input) != node.inputs + k;
+            if (last_reader[input] == i && !repeated) {
+                free_registers.push_back(registers[input]);
+            }
+        }
+    }
+    result = registers[output];
+    return true;
+}
+
+// the arithmetic over a block, one kernel per op
+
+static void add_run(int n, const float *__restrict a, const float *__restrict b, float *__restrict out) {
+    for (int i=0; i<n; i++) out[i] = a[i] + b[i];
+}
+
+static void subtract_run(int n, const float *__restrict a, const float *__restrict b, float *__restrict out) {
+    for (int i=0; i<n; i++) out[i] = a[i] - b[i];
+}
+
+static void multiply_run(int n, const float *__restrict a, const float *__restrict b, float *__restrict out) {
+    for (int i=0; i<n; i++) out[i] = a[i]*b[i];
+}
+
+static void minimum_run(int n, const float *__restrict a, const float *__restrict b, float *__restrict out) {
+    for (int i=0; i<n; i++) out[i] = std::min(a[i], b[i]);
+}
+
+static void maximum_run(int n, const float *__restrict a, const float *__restrict b, float *__restrict out) {
+    for (int i=0; i<n; i++) out[i] = std::max(a[i], b[i]);
+}
+
+static void multiply_add_run(int n, const float *__restrict a, const float *__restrict b,
+        const float *__restrict c, float *__restrict out) {
+    for (int i=0; i<n; i++) out[i] = a[i]*b[i] + c[i];
+}
+
+static void mix_run(int n, const float *__restrict a, const float *__restrict b,
+        const float *__restrict t, float *__restrict out) {
+    for (int i=0; i<n; i++) out[i] = a[i] + (b[i] - a[i])*t[i];
+}
+
+static void affine_run(int n, const float *__restrict a, float scale, float offset, float *__restrict out) {
+    for (int i=0; i<n; i++) out[i] = a[i]*scale + offset;
+}
+
+static void absolute_run(int n, const float *__restrict a, float *__restrict out) {
+    for (int i=0; i<n; i++) out[i] = fabsf(a[i]);
+}
+
+static void clamp_run(int n, const float *__restrict a, float low, float high, float *__restrict out) {
+    for (int i=0; i<n; i++) out[i] = std::min(std::max(a[i], low), high);
+}
+
+static void smoothstep_run(int n, const float *__restrict a, float low, float high, float *__restrict out) {
+    // clamped then eased in two loops, gcc won't if-convert the two in one
+    float scale = 1 / (high - low);
+    for (int i=0; i<n; i++) {
+        out[i] = std::min(std::max((a[i] - low)*scale, 0.0f), 1.0f);
+    }
+    for (int i=0; i<n; i++) {
+        out[i] = out[i]*out[i]*(3 - 2*out[i]);
+    }
+}
+
+static void accumulate_run(int n, const float *__restrict a, float *__restrict out) {
+    for (int i=0; i<n; i++) out[i] += a[i];
+}
+
+static void add_ridge_run(int n, const float *__restrict noise, float amplitude, float *__restrict out) {
+    for (int i=0; i<n; i++) {
+        float ridge = 1 - 2*fabsf(noise[i]);
+        out[i] += amplitude*ridge*ridge;
+    }
+}
+
+void NoiseProgram::run_block(int n, const float *x, const float *y, float *heights, float *registers) {
+    // past the registers, the octave the accumulating ops add
+    float *scratch = registers + (size_t)register_count*NOISE_BLOCK;
+    for (NoiseInstruction &instruction : instructions) {
+        float *out = registers + (size_t)instruction.target*NOISE_BLOCK;
+        const float *a = registers + (size_t)std::max(instruction.a, 0)*NOISE_BLOCK;
+        const float *b = registers + (size_t)std::max(instruction.b, 0)*NOISE_BLOCK;
+        const float *c = registers + (size_t)std::max(instruction.c, 0)*NOISE_BLOCK;
+        switch (instruction.op) {
+            case NOISE_OP_X: std::copy(x, x + n, out); break;
+            case NOISE_OP_Y: std::copy(y, y + n, out); break;
+            case NOISE_OP_CONSTANT: std::fill(out, out + n, instruction.value); break;
+            case NOISE_OP_NOISE: instruction.noise.get_heights2D(n, a, b, out); break;
+            case NOISE_OP_WORLEY: instruction.cells.get_heights2D(n, a, b, out); break;
+            case NOISE_OP_ADD_NOISE:
+                instruction.noise.get_heights2D(n, a, b, scratch);
+                accumulate_run(n, scratch, out);
+                break;
+            case NOISE_OP_ADD_RIDGE:
+                instruction.noise.get_heights2D(n, a, b, scratch);
+                add_ridge_run(n, scratch, instruction.value, out);
+                break;
+            case NOISE_OP_ADD: add_run(n, a, b, out); break;
+            case NOISE_OP_SUBTRACT: subtract_run(n, a, b, out); break;
+            case NOISE_OP_MULTIPLY: multiply_run(n, a, b, out); break;
+            case NOISE_OP_MINIMUM: minimum_run(n, a, b, out); break;
+            case NOISE_OP_MAXIMUM: maximum_run(n, a, b, out); break;
+            case NOISE_OP_ABSOLUTE: absolute_run(n, a, out); break;
+            case NOISE_OP_MIX: mix_run(n, a, b, c, out); break;
+            case NOISE_OP_CLAMP: clamp_run(n, a, instruction.value, instruction.value2, out); break;
+            case NOISE_OP_SMOOTHSTEP: smoothstep_run(n, a, instruction.value, instruction.value2, out); break;
+            case NOISE_OP_MULTIPLY_ADD: multiply_add_run(n, a, b, c, out); break;
+            case NOISE_OP_AFFINE: affine_run(n, a, instruction.value, instruction.value2, out); break;
+            case NOISE_OP_FBM:
+            case NOISE_OP_RIDGED:
+                break;
+        }
+    }
+    const float *value = registers + (size_t)result*NOISE_BLOCK;
+    std::copy(value, value + n, heights);
+}
+
+void NoiseProgram::evaluate(int count, const float *x, const float *y, float *heights) {
+    if (result < 0) {
+        return;
+    }
+    // per thread so rows can be evaluated in parallel without allocating
+    static thread_local std::vector<float> registers;
+    registers.resize((size_t)(register_count + 1)*NOISE_BLOCK);
+    for (int first=0; first<count; first+=NOISE_BLOCK) {
+        int n = std::min(count - first, NOISE_BLOCK);
+        run_block(n, x + first, y + first, heights + first, &registers[0]);
+    }
+}
+
+void NoiseProgram::generate(Heightfield &terrain, ThreadPool &pool) {
+    int grain = std::max(1, 4096 / std::max(1, terrain.columns));
+    pool.parallel_for(terrain.rows, grain, [&](int begin, int end) {
+        static thread_local std::vector<float> x, y;
+        x.resize(terrain.columns);
+        y.resize(terrain.columns);
+        for (int i=0; i<terrain.columns; i++) {
+            x[i] = terrain.get_x(i);
+        }
+        for (int j=begin; j<end; j++) {
+            std::fill(y.begin(), y.end(), terrain.get_y(j));
+            evaluate(terrain.columns, &x[0], &y[0], &terrain.heights[terrain.index(0, j)]);
+        }
+    });
+    terrain.compute_normals();
+}
@@ -0,0 +1,136 @@
+#ifndef NOISE_GRAPH_H
+#define NOISE_GRAPH_H
+
+#include "heightfield.h"
+#include "pnoise.h"
+#include "thread_pool.h"
+#include "worley.h"
+#include <string>
+#include <vector>
+
+// points a program runs through at a time. every register holds a block,
+// so with the usual dozen or so registers they all stay in L1
+#define NOISE_BLOCK 256
+
+enum NoiseOp {
+    NOISE_OP_X, NOISE_OP_Y, NOISE_OP_CONSTANT,
+    // PNoise at the points (a, b), fbm and ridged sum octaves of it
+    NOISE_OP_NOISE, NOISE_OP_FBM, NOISE_OP_RIDGED,
+    // WorleyNoise at the points (a, b)
+    NOISE_OP_WORLEY,
+    NOISE_OP_ADD, NOISE_OP_SUBTRACT, NOISE_OP_MULTIPLY, NOISE_OP_MINIMUM, NOISE_OP_MAXIMUM,
+    NOISE_OP_ABSOLUTE,
+    // a + (b - a)*c
+    NOISE_OP_MIX,
+    // a clamped to [value, value2], and 0 to 1 eased between them
+    NOISE_OP_CLAMP, NOISE_OP_SMOOTHSTEP,
+    // made by the compiler: a*b + c, a*value + value2, and the noise of one
+    // octave added to the register it writes
+    NOISE_OP_MULTIPLY_ADD, NOISE_OP_AFFINE, NOISE_OP_ADD_NOISE, NOISE_OP_ADD_RIDGE
+};
+
+struct NoiseNode {
+    NoiseOp op;
+    // earlier nodes, -1 when unused
+    int inputs[3];
+    float value = 0, value2 = 0;
+    // for the noise ops, octaves scale its wavelength down by lacunarity and
+    // its amplitude by gain, and use the next seeds
+    PNoise noise;
+    int octaves = 1;
+    float lacunarity = 2.0f, gain = 0.5f;
+    // for the worley op
+    WorleyNoise cells;
+};
+
+// a height as a graph of noises and arithmetic over the point's x and y.
+// the builder functions return the new node's id, nodes only take earlier
+// nodes as inputs so the list is always in evaluation order
+class NoiseGraph {
+    private:
+        std::vector<NoiseNode> nodes;
+        int output = -1;
+
+        int add_node(NoiseOp op, int a = -1, int b = -1, int c = -1, float value = 0, float value2 = 0);
+
+    public:
+        NoiseGraph() {}
+
+        int x() { return add_node(NOISE_OP_X); }
+        int y() { return add_node(NOISE_OP_Y); }
+        int constant(float value) { return add_node(NOISE_OP_CONSTANT, -1, -1, -1, value); }
+        int noise(int x, int y, const PNoise &noise);
+        int fbm(int x, int y, const PNoise &noise, int octaves, float lacunarity = 2.0f, float gain = 0.5f);
+        // octaves of (1 - 2|n|)^2 for noise n of amplitude 1, times the
+        // noise's amplitude, sharp crests where the noise crosses 0
+        int ridged(int x, int y, const PNoise &noise, int octaves, float lacunarity = 2.0f, float gain = 0.5f);
+        int worley(int x, int y, const WorleyNoise &noise);
+        int add(int a, int b) { return add_node(NOISE_OP_ADD, a, b); }
+        int subtract(int a, int b) { return add_node(NOISE_OP_SUBTRACT, a, b); }
+        int multiply(int a, int b) { return add_node(NOISE_OP_MULTIPLY, a, b); }
+        int minimum(int a, int b) { return add_node(NOISE_OP_MINIMUM, a, b); }
+        int maximum(int a, int b) { return add_node(NOISE_OP_MAXIMUM, a, b); }
+        int absolute(int a) { return add_node(NOISE_OP_ABSOLUTE, a); }
+        int mix(int a, int b, int t) { return add_node(NOISE_OP_MIX, a, b, t); }
+        int clamp(int a, float low, float high) { return add_node(NOISE_OP_CLAMP, a, -1, -1, low, high); }
+        int smoothstep(int a, float low, float high) { return add_node(NOISE_OP_SMOOTHSTEP, a, -1, -1, low, high); }
+
+        void set_output(int node) { output = node; }
+        int get_output() const { return output; }
+        int get_count() const { return nodes.size(); }
+        const NoiseNode &get(int node) const { return nodes[node]; }
+
+        // a text file with a node per line, `name = op operands...`, and an
+        // `output name` line. operands are earlier names, x, y or numbers:
+        //   noise <x> <y> <seed> <wavelength> [amplitude]
+        //   fbm|ridged <x> <y> <seed> <wavelength> <octaves> [amplitude]
+        //   worley <x> <y> <seed> <wavelength> <f1|f2|f2-f1> [amplitude]
+        //   add|sub|mul|min|max <a> <b>, abs <a>, mix <a> <b> <t>
+        //   clamp|smoothstep <a> <low> <high>
+        // # starts a comment. false, with the line logged, if the file
+        // can't be read or parsed
+        bool load(const std::string &path);
+        bool parse(const std::string &text);
+};
+
+struct NoiseInstruction {
+    NoiseOp op;
+    // registers
+    int target, a, b, c;
+    float value, value2;
+    // the noise of the noise ops, one instruction per octave, and of the
+    // worley op
+    PNoise noise;
+    WorleyNoise cells;
+};
+
+// a graph compiled to a flat list of instructions over registers of
+// NOISE_BLOCK floats. constants are folded, nodes the output doesn't use are
+// dropped, multiplies feeding a single add fuse into one instruction,
+// octaves unroll and registers are reused once their last reader has run
+class NoiseProgram {
+    private:
+        std::vector<NoiseInstruction> instructions;
+        int register_count = 0;
+        // the register holding the output
+        int result = -1;
+
+        void run_block(int n, const float *x, const float *y, float *heights, float *registers);
+
+    public:
+        NoiseProgram() {}
+
+        // false if the graph has no output
+        bool compile(const NoiseGraph &graph);
+
+        int get_instruction_count() { return instructions.size(); }
+        int get_register_count() { return register_count; }
+
+        // the heights at count points, a block at a time
+        void evaluate(int count, const float *x, const float *y, float *heights);
+        // every point of the terrain, with the rows split over the pool, then
+        // normals from the heights
+        void generate(Heightfield &terrain, ThreadPool &pool);
+};
+
+#endif // NOISE_GRAPH_H
@@ -0,0 +1,259 @@
+#include "ocean_fft.h"
+#include "fast_math.h"
+#include "logger.h"
+#include "pnoise.h"
+#include "profiler.h"
+#include <algorithm>
+#include <math.h>
+
+#define PI 3.14159265359
+
+// spectral density of the wave vector (kx, ky), up to a constant factor
+// since the amplitudes are rescaled to the requested height afterwards
+static double spectrum_density(const OceanParameters &p, double kx, double ky) {
+    double k = sqrt(kx*kx + ky*ky);
+    if (k < 1e-6) {
+        return 0;
+    }
+    double g = p.gravity;
+    // waves travelling along the wind, none against it
+    double along = (kx*cos(p.wind_direction) + ky*sin(p.wind_direction)) / k;
+    if (along <= 0) {
+        return 0;
+    }
+
+    double density;
+    if (p.spectrum == SPECTRUM_JONSWAP) {
+        double omega = sqrt(g*k);
+        double peak = 22*pow(g*g / (p.wind_speed*p.fetch), 1.0/3);
+        double sigma = omega <= peak ? 0.07 : 0.09;
+        double r = exp(-(omega - peak)*(omega - peak) / (2*sigma*sigma*peak*peak));
+        double s = g*g / pow(omega, 5) * exp(-1.25*pow(peak/omega, 4)) * pow(3.3, r);
+        // from S(omega) to S(k): d omega / dk = g / (2 omega), over k for 2D
+        density = s * g / (2*omega) / k;
+    } else {
+        double l = p.wind_speed*p.wind_speed / g;
+        // waves much shorter than the largest ones are damped
+        double small = l / 1000;
+        density = exp(-1 / (k*l*k*l)) / (k*k*k*k) * exp(-k*k*small*small);
+    }
+    return density * along*along;
+}
+
+bool OceanFFT::setup(const OceanParameters &p) {
+    if (p.size < 64 || p.size > 1024 || (p.size & (p.size - 1)) != 0) {
+        return false;
+    }
+    parameters = p;
+    resize(p.size, p.length);
+    fft = FFT2D(size);
+
+    size_t count = (size_t)size*size;
+    std::vector<float> h0_re(count, 0), h0_im(count, 0);
+    omega.assign(count, 0);
+    chop_over_k.assign(count, 0);
+    kx.resize(size);
+    ky.resize(size);
+
+    double dk = 2*PI / p.length;
+    for (int i=0; i<size; i++) {
+        // FFT order, frequencies above the middle are the negative ones
+        kx[i] = (i < size/2 ? i : i - size) * dk;
+        ky[i] = kx[i];
+    }
+
+    double power = 0;
+    for (int j=0; j<size; j++) {
+        for (int i=0; i<size; i++) {
+            size_t index = (size_t)j*size + i;
+            int n = i < size/2 ? i : i - size;
+            int m = j < size/2 ? j : j - size;
+            double wx = n*dk, wy = m*dk;
+            double k = sqrt(wx*wx + wy*wy);
+
+            double w = sqrt(p.gravity*k);
+            if (p.loop_period > 0) {
+                // a whole number of cycles per period
+                double base = 2*PI / p.loop_period;
+                w = floor(w / base) * base;
+            }
+            omega[index] = w;
+            if (k > 0) {
+                chop_over_k[index] = p.choppiness / k;
+            }
+
+            // the Nyquist row and column have no conjugate partner, so they
+            // would leak imaginary parts into the packed transforms
+            if (i == size/2 || j == size/2) {
+                continue;
+            }
+
+            // two gaussians from the hashed lattice point, so the sea only
+            // depends on the seed and not on the order of generation
+            uint32_t h = hash2D(n, m, p.seed);
+            double u1 = ((h & 0xffff) + 0.5) / 65536.0;
+            double u2 = ((h >> 16) + 0.5) / 65536.0;
+            double radius = sqrt(-2*log(u1));
+            double amplitude = sqrt(spectrum_density(p, wx, wy) / 2);
+            h0_re[index] = radius*cos(2*PI*u2) * amplitude;
+            h0_im[index] = radius*sin(2*PI*u2) * amplitude;
+            power += h0_re[index]*h0_re[index] + h0_im[index]*h0_im[index];
+        }
+    }
+
+    // the mean square height is the sum of |h0(k)|^2 + |h0(-k)|^2
+    float scale = power > 0 ? p.height / sqrt(2*power) : 0;
+    h0_sum_re.resize(count);
+    h0_sum_im.resize(count);
+    h0_diff_re.resize(count);
+    h0_diff_im.resize(count);
+    for (int j=0; j<size; j++) {
+        for (int i=0; i<size; i++) {
+            size_t index = (size_t)j*size + i;
+            size_t mirror = (size_t)((size - j) % size)*size + (size - i) % size;
+            // conj(h0(-k))
+            float conj_re = h0_re[mirror]*scale, conj_im = -h0_im[mirror]*scale;
+            h0_sum_re[index] = h0_re[index]*scale + conj_re;
+            h0_sum_im[index] = h0_im[index]*scale + conj_im;
+            h0_diff_re[index] = h0_re[index]*scale - conj_re;
+            h0_diff_im[index] = h0_im[index]*scale - conj_im;
+        }
+    }
+
+    for (int i=0; i<3; i++) {
+        planes_re[i].assign(count, 0);
+        planes_im[i].assign(count, 0);
+    }
+    return true;
+}
+
+// one row of the spectrum, every wave vector of it independent
+static void evolve_row(int n, float time, float wave_y, const float *__restrict wave_x,
+        const float *__restrict sum_re, const float *__restrict sum_im,
+        const float *__restrict diff_re, const float *__restrict diff_im,
+        const float *__restrict omega, const float *__restrict chop_over_k,
+        float *__restrict p0r, float *__restrict p0i, float *__restrict p1r,
+        float *__restrict p1i, float *__restrict p2r, float *__restrict p2i) {
+    for (int i=0; i<n; i++) {
+        float s, c;
+        sincos_fast(omega[i]*time, s, c);
+
+        // h(k, t) = h0(k) e^(-i omega t) + conj(h0(-k)) e^(i omega t), the
+        // waves travel along k
+        float hr = sum_re[i]*c + diff_im[i]*s;
+        float hi = sum_im[i]*c - diff_re[i]*s;
+
+        // real fields a and b share a transform as a + ib. the slopes are
+        // ik h, the displacement i k/|k| h, towards the crests
+        float dx = wave_x[i]*chop_over_k[i], dy = wave_y*chop_over_k[i];
+        p0r[i] = hr - wave_x[i]*hr;
+        p0i[i] = hi - wave_x[i]*hi;
+        p1r[i] = -(dx*hi + dy*hr);
+        p1i[i] = dx*hr - dy*hi;
+        p2r[i] = -wave_y*hi;
+        p2i[i] = wave_y*hr;
+    }
+}
+
+void OceanFFT::evolve_rows(float time, int begin, int end) {
+    for (int j=begin; j<end; j++) {
+        size_t row = (size_t)j*size;
+        evolve_row(size, time, ky[j], &kx[0],
+                &h0_sum_re[row], &h0_sum_im[row], &h0_diff_re[row], &h0_diff_im[row],
+                &omega[row], &chop_over_k[row],
+                &planes_re[0][row], &planes_im[0][row], &planes_re[1][row],
+                &planes_im[1][row], &planes_re[2][row], &planes_im[2][row]);
+    }
+}
+
+void OceanFFT::update(float time, ThreadPool *pool) {
+    PROFILE_ZONE("ocean_update");
+    if (!size) {
+        return;
+    }
+
+    {
+        PROFILE_ZONE("ocean_spectrum");
+        // a few rows per chunk, the loop is short next to a wake-up
+        int grain = std::max(1, 16384 / size);
+        if (pool) {
+            pool->parallel_for(size, grain, [&](int begin, int end) { evolve_rows(time, begin, end); });
+        } else {
+            evolve_rows(time, 0, size);
+        }
+    }
+
+    {
+        PROFILE_ZONE("ocean_fft");
+        float *re[3] = { &planes_re[0][0], &planes_re[1][0], &planes_re[2][0] };
+        float *im[3] = { &planes_im[0][0], &planes_im[1][0], &planes_im[2][0] };
+        fft.inverse(3, re, im, pool);
+    }
+
+    heights.swap(planes_re[0]);
+    slope_x.swap(planes_im[0]);
+    displacement_x.swap(planes_re[1]);
+    displacement_y.swap(planes_im[1]);
+    slope_y.swap(planes_re[2]);
+}
+
+void OceanFFT::set_single_wave(int n, int m, float amplitude) {
+    std::fill(h0_sum_re.begin(), h0_sum_re.end(), 0.0f);
+    std::fill(h0_sum_im.begin(), h0_sum_im.end(), 0.0f);
+    std::fill(h0_diff_re.begin(), h0_diff_re.end(), 0.0f);
+    std::fill(h0_diff_im.begin(), h0_diff_im.end(), 0.0f);
+    // h0(k) = amplitude and h0(-k) = 0
+    size_t index = (size_t)((m%size + size) % size)*size + (n%size + size) % size;
+    size_t mirror = (size_t)((size - m%size) % size)*size + (size - n%size) % size;
+    h0_sum_re[index] = amplitude;
+    h0_diff_re[index] = amplitude;
+    h0_sum_re[mirror] = amplitude;
+    h0_diff_re[mirror] = -amplitude;
+}
+
+bool verify_ocean_fft() {
+    OceanParameters p;
+    p.size = 64;
+    OceanFFT ocean;
+    ocean.setup(p);
+    // 3 and 2 cycles per tile along x and y, so the wind doesn't matter
+    int n = 3, m = 2;
+    ocean.set_single_wave(n, m, 1.0f);
+    double wx = 2*PI*n / p.length, wy = 2*PI*m / p.length;
+    double k = sqrt(wx*wx + wy*wy);
+    double omega = sqrt(p.gravity*k);
+
+    // the phase of the wave, an eighth of a cycle after t = 0 a crest that
+    // started at the origin should be at k.x = pi/4
+    double time = PI/4 / omega;
+    ocean.update(time);
+    int size = ocean.get_size();
+    double across = 0, along = 0, compression = 0;
+    for (int j=0; j<size; j++) {
+        for (int i=0; i<size; i++) {
+            size_t index = (size_t)j*size + i;
+            double x = i*p.length/size, y = j*p.length/size;
+            double h = ocean.heights[index];
+            across += h*cos(wx*x + wy*y);
+            along += h*sin(wx*x + wy*y);
+
+            // the divergence of the displacement, negative where the points
+            // crowd together, which should be under the crests
+            size_t right = (size_t)j*size + (i + 1) % size;
+            size_t left = (size_t)j*size + (i + size - 1) % size;
+            size_t up = (size_t)((j + 1) % size)*size + i;
+            size_t down = (size_t)((j + size - 1) % size)*size + i;
+            double divergence = (ocean.displacement_x[right] - ocean.displacement_x[left]
+                    + ocean.displacement_y[up] - ocean.displacement_y[down]) / (2*p.length/size);
+            compression += h*divergence;
+        }
+    }
+    double phase = atan2(along, across);
+
+    bool downwind = fabs(phase - PI/4) < 0.05;
+    bool compresses = compression < 0;
+    bool ok = downwind && compresses;
+    log("ocean fft %s: wave phase %g (expected %g, %s), crests %s\n", ok ? "ok" : "WRONG",
+            phase, PI/4, downwind ? "downwind" : "NOT downwind", compresses ? "compress" : "STRETCH");
+    return ok;
+}
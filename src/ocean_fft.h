@@ -0,0 +1,82 @@
+#ifndef OCEAN_FFT_H
+#define OCEAN_FFT_H
+
+#include "fft.h"
+#include "ocean_surface.h"
+#include "thread_pool.h"
+#include <stdint.h>
+#include <vector>
+
+// the directional wave spectrum the ocean is built from
+enum OceanSpectrum {
+    // fully developed sea for the wind speed, P(k) ~ exp(-1/(kL)^2)/k^4
+    SPECTRUM_PHILLIPS,
+    // fetch limited sea, sharper peak, common for coastal water
+    SPECTRUM_JONSWAP
+};
+
+struct OceanParameters {
+    // grid points per side, a power of two between 64 and 1024
+    int size = 256;
+    // world units covered by one tile, the surface repeats after it
+    float length = 10.0f;
+    // wind speed (units per second) and direction (radians, 0 is +x)
+    float wind_speed = 3.0f;
+    float wind_direction = 0.0f;
+    // distance the wind has blown over water, for SPECTRUM_JONSWAP
+    float fetch = 50.0f;
+    OceanSpectrum spectrum = SPECTRUM_PHILLIPS;
+    // RMS height of the surface, the spectrum is scaled to it
+    float height = 0.1f;
+    // scale of the horizontal displacement, 0 gives round crests, 1 sharp ones
+    float choppiness = 1.0f;
+    float gravity = 9.81f;
+    uint32_t seed = 0;
+    // seconds after which the surface repeats exactly, 0 for never. every
+    // frequency is rounded down to a multiple of 2 pi / loop_period
+    float loop_period = 0.0f;
+};
+
+// Tessendorf's statistical ocean: random amplitudes drawn from the spectrum
+// are advanced in time in frequency space and transformed to heights,
+// horizontal displacement and slopes with three inverse FFTs per update,
+// two real fields packed into every complex transform
+class OceanFFT : public OceanSurface {
+    private:
+        OceanParameters parameters;
+        FFT2D fft;
+
+        // per wave vector, structure of arrays so the update vectorizes:
+        // h0(k) + conj(h0(-k)), h0(k) - conj(h0(-k)), the angular frequency
+        // and choppiness/|k|. kx only depends on the column and ky on the row
+        std::vector<float> h0_sum_re, h0_sum_im, h0_diff_re, h0_diff_im;
+        std::vector<float> omega, chop_over_k;
+        std::vector<float> kx, ky;
+
+        // the three transforms: height + i slope x, displacement x + i
+        // displacement y and slope y
+        std::vector<float> planes_re[3], planes_im[3];
+
+        // evolve the spectrum of rows [begin, end) to time t
+        void evolve_rows(float time, int begin, int end);
+
+    public:
+        OceanFFT() {}
+
+        // draw the initial spectrum, false if the size isn't supported
+        bool setup(const OceanParameters &parameters);
+        const OceanParameters &get_parameters() { return parameters; }
+
+        // compute the surface at time t (seconds), on the pool when given one
+        void update(float time, ThreadPool *pool = NULL);
+
+        // replace the spectrum drawn by setup with a single wave of n and m
+        // cycles per tile along x and y, for checking the surface
+        void set_single_wave(int n, int m, float amplitude);
+};
+
+// check that a single wave travels along its wave vector and that the
+// displacement gathers the points under its crests, logging the result
+bool verify_ocean_fft();
+
+#endif // OCEAN_FFT_H
@@ -0,0 +1,206 @@
+#include "ocean_loop.h"
+#include "logger.h"
+#include "profiler.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+// header of a baked loop, followed by frames frames of the five fields
+// (heights, displacement x and y, slope x and y) as size*size unsigned
+// samples of bits bits each
+struct OceanLoopHeader {
+    char magic[4];
+    uint32_t version;
+    int32_t size, frames, bits;
+    float period, length;
+    float scale[5], offset[5];
+};
+
+static const char OCEAN_LOOP_MAGIC[4] = { 'O', 'B', 'L', 'P' };
+// 2: the waves travel downwind and the displacement gathers them at the crests
+static const uint32_t OCEAN_LOOP_VERSION = 2;
+
+// the fields of a surface in file order
+static void surface_fields(OceanSurface &surface, std::vector<float> *fields[5]) {
+    fields[0] = &surface.heights;
+    fields[1] = &surface.displacement_x;
+    fields[2] = &surface.displacement_y;
+    fields[3] = &surface.slope_x;
+    fields[4] = &surface.slope_y;
+}
+
+template <typename T>
+static bool write_field(FILE *file, const std::vector<float> &values, float offset, float scale,
+        std::vector<T> &samples) {
+    float inverse = scale > 0 ? 1 / scale : 0;
+    samples.resize(values.size());
+    for (size_t i=0; i<values.size(); i++) {
+        samples[i] = (T)lrintf((values[i] - offset) * inverse);
+    }
+    return fwrite(&samples[0], sizeof(T), samples.size(), file) == samples.size();
+}
+
+bool OceanLoop::bake(const OceanParameters &parameters, int frames, int bits,
+        const std::string &path, ThreadPool *pool) {
+    if (parameters.loop_period <= 0 || frames < 2 || (bits != 8 && bits != 16)) {
+        return false;
+    }
+    OceanFFT ocean;
+    if (!ocean.setup(parameters)) {
+        return false;
+    }
+    std::vector<float> *fields[5];
+    surface_fields(ocean, fields);
+    float period = parameters.loop_period;
+
+    // first pass for the range of every field, the quantization spans it
+    float min[5], max[5];
+    std::fill(min, min + 5, FLT_MAX);
+    std::fill(max, max + 5, -FLT_MAX);
+    for (int f=0; f<frames; f++) {
+        ocean.update(f * period / frames, pool);
+        for (int p=0; p<5; p++) {
+            const std::vector<float> &values = *fields[p];
+            for (size_t i=0; i<values.size(); i++) {
+                min[p] = std::min(min[p], values[i]);
+                max[p] = std::max(max[p], values[i]);
+            }
+        }
+    }
+
+    OceanLoopHeader header;
+    memcpy(header.magic, OCEAN_LOOP_MAGIC, sizeof(OCEAN_LOOP_MAGIC));
+    header.version = OCEAN_LOOP_VERSION;
+    header.size = parameters.size;
+    header.frames = frames;
+    header.bits = bits;
+    header.period = period;
+    header.length = parameters.length;
+    float levels = bits == 8 ? 255.0f : 65535.0f;
+    for (int p=0; p<5; p++) {
+        header.offset[p] = min[p];
+        header.scale[p] = (max[p] - min[p]) / levels;
+    }
+
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file) {
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1;
+
+    // second pass runs the simulation again rather than keeping every frame
+    std::vector<uint8_t> samples8;
+    std::vector<uint16_t> samples16;
+    for (int f=0; f<frames && ok; f++) {
+        ocean.update(f * period / frames, pool);
+        for (int p=0; p<5 && ok; p++) {
+            if (bits == 8) {
+                ok = write_field(file, *fields[p], header.offset[p], header.scale[p], samples8);
+            } else {
+                ok = write_field(file, *fields[p], header.offset[p], header.scale[p], samples16);
+            }
+        }
+    }
+    ok &= fclose(file) == 0;
+    return ok;
+}
+
+bool OceanLoop::open(const std::string &path) {
+    close();
+    if (!file.open(path)) {
+        return false;
+    }
+
+    OceanLoopHeader header;
+    bool ok = file.get_size() >= sizeof(header);
+    if (ok) {
+        memcpy(&header, file.get_data(), sizeof(header));
+        ok = memcmp(header.magic, OCEAN_LOOP_MAGIC, sizeof(OCEAN_LOOP_MAGIC)) == 0
+            && header.version == OCEAN_LOOP_VERSION
+            && header.size >= 2 && header.size <= 4096 && (header.size & (header.size - 1)) == 0
+            && header.frames >= 2 && (header.bits == 8 || header.bits == 16)
+            && header.period > 0 && header.length > 0;
+    }
+    if (ok) {
+        size_t bytes = header.bits / 8;
+        size_t expected = sizeof(header) + (size_t)header.frames * 5 * header.size * header.size * bytes;
+        ok = file.get_size() == expected;
+    }
+    if (!ok) {
+        file.close();
+        return false;
+    }
+
+    frames = header.frames;
+    sample_bytes = header.bits / 8;
+    period = header.period;
+    memcpy(scale, header.scale, sizeof(scale));
+    memcpy(offset, header.offset, sizeof(offset));
+    frame_data = file.get_data() + sizeof(header);
+    resize(header.size, header.length);
+    return true;
+}
+
+void OceanLoop::close() {
+    file.close();
+    frame_data = NULL;
+    frames = 0;
+    resize(0, 0);
+}
+
+// out = offset + scale*((1 - t)*a + t*b), decoding and blending two frames
+template <typename T>
+static void blend_samples(int n, const T *__restrict a, const T *__restrict b, float t,
+        float scale, float offset, float *__restrict out) {
+    float scale_a = scale * (1 - t), scale_b = scale * t;
+    for (int i=0; i<n; i++) {
+        out[i] = offset + scale_a*a[i] + scale_b*b[i];
+    }
+}
+
+void OceanLoop::blend_rows(int a, int b, float t, int begin, int end) {
+    std::vector<float> *fields[5];
+    surface_fields(*this, fields);
+    size_t count = (size_t)size*size;
+    size_t first = (size_t)begin*size;
+    int n = (end - begin)*size;
+
+    for (int p=0; p<5; p++) {
+        float *out = &(*fields[p])[first];
+        size_t index_a = ((size_t)a*5 + p)*count + first;
+        size_t index_b = ((size_t)b*5 + p)*count + first;
+        if (sample_bytes == 1) {
+            const uint8_t *samples = (const uint8_t *)frame_data;
+            blend_samples(n, samples + index_a, samples + index_b, t, scale[p], offset[p], out);
+        } else {
+            const uint16_t *samples = (const uint16_t *)frame_data;
+            blend_samples(n, samples + index_a, samples + index_b, t, scale[p], offset[p], out);
+        }
+    }
+}
+
+void OceanLoop::update(float time, ThreadPool *pool) {
+    PROFILE_ZONE("ocean_loop_update");
+    if (!size) {
+        return;
+    }
+
+    float position = fmodf(time, period);
+    if (position < 0) {
+        position += period;
+    }
+    position = position / period * frames;
+    int a = std::min((int)position, frames - 1);
+    int b = (a + 1) % frames;
+    float t = position - a;
+
+    // a few rows per chunk, each is a short pass over memory
+    int grain = std::max(1, 16384 / size);
+    if (pool) {
+        pool->parallel_for(size, grain, [&](int begin, int end) { blend_rows(a, b, t, begin, end); });
+    } else {
+        blend_rows(a, b, t, 0, size);
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef OCEAN_LOOP_H
+#define OCEAN_LOOP_H
+
+#include "mapped_file.h"
+#include "ocean_fft.h"
+#include "ocean_surface.h"
+#include "thread_pool.h"
+#include <stdint.h>
+#include <string>
+
+// an FFT ocean baked over one loop period into a file of quantized frames
+// and played back by blending the two frames around the current time, which
+// costs a pass over memory instead of three FFTs a frame. the file is memory
+// mapped so only the frames being played are paged in
+class OceanLoop : public OceanSurface {
+    private:
+        MappedFile file;
+        int frames = 0;
+        // bytes per sample, 1 or 2
+        int sample_bytes = 0;
+        float period = 0;
+        // dequantized value = offset + scale*sample, per field
+        float scale[5], offset[5];
+        const char *frame_data = NULL;
+
+        // blend rows [begin, end) of frames a and b with weight t of b
+        void blend_rows(int a, int b, float t, int begin, int end);
+
+    public:
+        OceanLoop() {}
+
+        // run the simulation of parameters over parameters.loop_period
+        // seconds and write frames evenly spaced samples of it with 8 or 16
+        // bits each to path. false if the period, frame count, bits or size
+        // aren't supported or the file can't be written
+        static bool bake(const OceanParameters &parameters, int frames, int bits,
+                const std::string &path, ThreadPool *pool = NULL);
+
+        // map a baked loop, false if it can't be read or isn't one
+        bool open(const std::string &path);
+        void close();
+
+        int get_frames() { return frames; }
+        float get_period() { return period; }
+
+        // the surface at time t (seconds), wrapped onto the period
+        void update(float time, ThreadPool *pool = NULL);
+};
+
+#endif // OCEAN_LOOP_H
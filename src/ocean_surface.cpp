@@ -0,0 +1,140 @@
+#include "ocean_surface.h"
+#include "fast_math.h"
+#include <math.h>
+
+// points a query works through at a time, every step keeps a few arrays
+// of them on the stack
+#define OCEAN_QUERY_BLOCK 64
+
+void OceanSurface::resize(int size, float length) {
+    this->size = size;
+    this->length = length;
+    size_t count = (size_t)size*size;
+    heights.assign(count, 0);
+    displacement_x.assign(count, 0);
+    displacement_y.assign(count, 0);
+    slope_x.assign(count, 0);
+    slope_y.assign(count, 0);
+}
+
+void OceanSurface::sample(float x, float y, Eigen::Vector3f &displacement, Eigen::Vector2f &slope) {
+    float u = x / length * size;
+    float v = y / length * size;
+    float fu = floorf(u), fv = floorf(v);
+    float tu = u - fu, tv = v - fv;
+    // wrap onto the tile, the size is a power of two so a mask does it for
+    // negative coordinates too
+    int mask = size - 1;
+    int i0 = (int)fu & mask, j0 = (int)fv & mask;
+    int i1 = (i0 + 1) & mask, j1 = (j0 + 1) & mask;
+
+    size_t a = (size_t)j0*size + i0, b = (size_t)j0*size + i1;
+    size_t c = (size_t)j1*size + i0, d = (size_t)j1*size + i1;
+    float wa = (1 - tu)*(1 - tv), wb = tu*(1 - tv), wc = (1 - tu)*tv, wd = tu*tv;
+
+    displacement = Eigen::Vector3f(
+            wa*displacement_x[a] + wb*displacement_x[b] + wc*displacement_x[c] + wd*displacement_x[d],
+            wa*displacement_y[a] + wb*displacement_y[b] + wc*displacement_y[c] + wd*displacement_y[d],
+            wa*heights[a] + wb*heights[b] + wc*heights[c] + wd*heights[d]);
+    slope = Eigen::Vector2f(
+            wa*slope_x[a] + wb*slope_x[b] + wc*slope_x[c] + wd*slope_x[d],
+            wa*slope_y[a] + wb*slope_y[b] + wc*slope_y[c] + wd*slope_y[d]);
+}
+
+// the corners of the grid cells n points fall in, as indices into the
+// fields, and their bilinear weights. scale turns world units into grid
+// points
+struct BilinearBlock {
+    int a[OCEAN_QUERY_BLOCK], b[OCEAN_QUERY_BLOCK], c[OCEAN_QUERY_BLOCK], d[OCEAN_QUERY_BLOCK];
+    float wa[OCEAN_QUERY_BLOCK], wb[OCEAN_QUERY_BLOCK], wc[OCEAN_QUERY_BLOCK], wd[OCEAN_QUERY_BLOCK];
+};
+
+static void bilinear_points(int n, int size, float scale, const float *__restrict x,
+        const float *__restrict y, BilinearBlock &block) {
+    int *__restrict a = block.a, *__restrict b = block.b, *__restrict c = block.c, *__restrict d = block.d;
+    float *__restrict wa = block.wa, *__restrict wb = block.wb;
+    float *__restrict wc = block.wc, *__restrict wd = block.wd;
+    // the size is a power of two, so a mask wraps negative coordinates too
+    int mask = size - 1;
+    for (int i=0; i<n; i++) {
+        float u = x[i]*scale, v = y[i]*scale;
+        int fu = floor_fast(u), fv = floor_fast(v);
+        float tu = u - fu, tv = v - fv;
+        int i0 = fu & mask, j0 = fv & mask;
+        int i1 = (i0 + 1) & mask, j1 = (j0 + 1) & mask;
+        a[i] = j0*size + i0;
+        b[i] = j0*size + i1;
+        c[i] = j1*size + i0;
+        d[i] = j1*size + i1;
+        wa[i] = (1 - tu)*(1 - tv);
+        wb[i] = tu*(1 - tv);
+        wc[i] = (1 - tu)*tv;
+        wd[i] = tu*tv;
+    }
+}
+
+// one field at the points of the block
+static void gather(int n, const float *__restrict field, const BilinearBlock &block, float *__restrict out) {
+    const int *__restrict a = block.a, *__restrict b = block.b, *__restrict c = block.c, *__restrict d = block.d;
+    const float *__restrict wa = block.wa, *__restrict wb = block.wb;
+    const float *__restrict wc = block.wc, *__restrict wd = block.wd;
+    for (int i=0; i<n; i++) {
+        out[i] = wa[i]*field[a[i]] + wb[i]*field[b[i]] + wc[i]*field[c[i]] + wd[i]*field[d[i]];
+    }
+}
+
+// px = qx - dx and py = qy - dy, one fixed point step
+static void move_back(int n, const float *__restrict qx, const float *__restrict qy,
+        const float *__restrict dx, const float *__restrict dy, float *__restrict px, float *__restrict py) {
+    for (int i=0; i<n; i++) {
+        px[i] = qx[i] - dx[i];
+        py[i] = qy[i] - dy[i];
+    }
+}
+
+// unit normals (-sx, -sy, 1) normalized
+static void slope_normals(int n, const float *__restrict sx, const float *__restrict sy,
+        float *__restrict normal_x, float *__restrict normal_y, float *__restrict normal_z) {
+    for (int i=0; i<n; i++) {
+        float scale = 1 / sqrt_fast(sx[i]*sx[i] + sy[i]*sy[i] + 1);
+        normal_x[i] = -sx[i]*scale;
+        normal_y[i] = -sy[i]*scale;
+        normal_z[i] = scale;
+    }
+}
+
+void OceanSurface::query(WaterQuery &query) {
+    query.resize_outputs();
+    int count = query.size();
+    if (!count) {
+        return;
+    }
+
+    float scale = size / length;
+    BilinearBlock block;
+    float dx[OCEAN_QUERY_BLOCK], dy[OCEAN_QUERY_BLOCK];
+    float sx[OCEAN_QUERY_BLOCK], sy[OCEAN_QUERY_BLOCK];
+    for (int first=0; first<count; first+=OCEAN_QUERY_BLOCK) {
+        int n = count - first < OCEAN_QUERY_BLOCK ? count - first : OCEAN_QUERY_BLOCK;
+        const float *qx = &query.x[first], *qy = &query.y[first];
+        float *px = &query.rest_x[first], *py = &query.rest_y[first];
+
+        // start from the query points, the horizontal displacement is small
+        for (int i=0; i<n; i++) {
+            px[i] = qx[i];
+            py[i] = qy[i];
+        }
+        for (int step=0; step<OCEAN_QUERY_STEPS; step++) {
+            bilinear_points(n, size, scale, px, py, block);
+            gather(n, &displacement_x[0], block, dx);
+            gather(n, &displacement_y[0], block, dy);
+            move_back(n, qx, qy, dx, dy, px, py);
+        }
+
+        bilinear_points(n, size, scale, px, py, block);
+        gather(n, &heights[0], block, &query.height[first]);
+        gather(n, &slope_x[0], block, sx);
+        gather(n, &slope_y[0], block, sy);
+        slope_normals(n, sx, sy, &query.normal_x[first], &query.normal_y[first], &query.normal_z[first]);
+    }
+}
@@ -0,0 +1,45 @@
+#ifndef OCEAN_SURFACE_H
+#define OCEAN_SURFACE_H
+
+#include "water_query.h"
+#include <Eigen/Core>
+#include <vector>
+
+// fixed point steps a query takes to find the point that moved over it
+#define OCEAN_QUERY_STEPS 5
+
+// a tiling ocean surface known on a size x size grid, filled by the FFT
+// simulation or played back from a baked loop
+class OceanSurface {
+    protected:
+        int size = 0;
+        // world units covered by one tile
+        float length = 0;
+
+        // allocate zeroed fields for a size x size grid over length units
+        void resize(int size, float length);
+
+    public:
+        // size*size values stored row after row, point (i, j) sitting at
+        // (i, j)*length/size
+        std::vector<float> heights;
+        std::vector<float> displacement_x, displacement_y;
+        std::vector<float> slope_x, slope_y;
+
+        bool is_ready() { return size > 0; }
+        int get_size() { return size; }
+        float get_length() { return length; }
+
+        // bilinear sample of the tiled surface at world (x, y): the
+        // displacement (dx, dy, height) and the height slopes (dz/dx, dz/dy)
+        void sample(float x, float y, Eigen::Vector3f &displacement, Eigen::Vector2f &slope);
+
+        // the surface above the query's world points, a block of points at a
+        // time. the rest point that moved over each one is found by fixed
+        // point iteration, which converges while the crests don't fold over.
+        // every step finds the cells and weights of the whole block, then
+        // gathers the displacement one field at a time
+        void query(WaterQuery &query);
+};
+
+#endif // OCEAN_SURFACE_H
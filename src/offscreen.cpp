@@ -0,0 +1,206 @@
+#include "offscreen.h"
+#include "logger.h"
+#include <string.h>
+#include <vector>
+
+#ifdef OCEAN_HAS_EGL
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+// true if the space separated list names the extension
+static bool has_extension(const char *extensions, const char *name) {
+    size_t len = strlen(name);
+    for (const char *p = extensions ? strstr(extensions, name) : NULL; p; p = strstr(p + len, name)) {
+        if ((p == extensions || p[-1] == ' ') && (p[len] == ' ' || p[len] == '\0')) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// the surfaceless platform needs no display server or window system at all,
+// anything else goes through the default display
+static EGLDisplay open_display() {
+    const char *client = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+    if (has_extension(client, "EGL_MESA_platform_surfaceless")) {
+        PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+            (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+        if (get_platform_display) {
+            EGLDisplay display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+            if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL)) {
+                return display;
+            }
+        }
+    }
+    EGLDisplay display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+    if (display != EGL_NO_DISPLAY && eglInitialize(display, NULL, NULL)) {
+        return display;
+    }
+    return EGL_NO_DISPLAY;
+}
+
+static bool choose_config(EGLDisplay display, EGLint surface_type, EGLConfig &config) {
+    const EGLint attributes[] = {
+        EGL_SURFACE_TYPE, surface_type,
+        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+        EGL_RED_SIZE, 8,
+        EGL_GREEN_SIZE, 8,
+        EGL_BLUE_SIZE, 8,
+        EGL_DEPTH_SIZE, 24,
+        EGL_NONE
+    };
+    EGLint count = 0;
+    return eglChooseConfig(display, attributes, &config, 1, &count) && count > 0;
+}
+
+bool OffscreenContext::create(int width, int height) {
+    destroy();
+    this->width = width;
+    this->height = height;
+
+    EGLDisplay egl_display = open_display();
+    if (egl_display == EGL_NO_DISPLAY) {
+        log("offscreen: no EGL display\n");
+        return false;
+    }
+    display = egl_display;
+
+    // the renderer uses the fixed function pipeline, so desktop GL
+    if (!eglBindAPI(EGL_OPENGL_API)) {
+        log("offscreen: EGL has no desktop OpenGL\n");
+        destroy();
+        return false;
+    }
+
+    // prefer a pbuffer, it behaves like a window's default framebuffer
+    EGLConfig config;
+    bool pbuffer = choose_config(egl_display, EGL_PBUFFER_BIT, config);
+    if (!pbuffer) {
+        bool surfaceless = has_extension(eglQueryString(egl_display, EGL_EXTENSIONS), "EGL_KHR_surfaceless_context");
+        if (!surfaceless || !choose_config(egl_display, 0, config)) {
+            log("offscreen: no EGL config with pbuffers or surfaceless contexts\n");
+            destroy();
+            return false;
+        }
+    }
+
+    EGLContext egl_context = eglCreateContext(egl_display, config, EGL_NO_CONTEXT, NULL);
+    if (egl_context == EGL_NO_CONTEXT) {
+        log("offscreen: could not create a context (EGL error 0x%x)\n", eglGetError());
+        destroy();
+        return false;
+    }
+    context = egl_context;
+
+    EGLSurface egl_surface = EGL_NO_SURFACE;
+    if (pbuffer) {
+        const EGLint attributes[] = { EGL_WIDTH, width, EGL_HEIGHT, height, EGL_NONE };
+        egl_surface = eglCreatePbufferSurface(egl_display, config, attributes);
+        if (egl_surface == EGL_NO_SURFACE) {
+            log("offscreen: could not create a %dx%d pbuffer (EGL error 0x%x)\n", width, height, eglGetError());
+            destroy();
+            return false;
+        }
+        surface = egl_surface;
+    }
+
+    if (!eglMakeCurrent(egl_display, egl_surface, egl_surface, egl_context)) {
+        log("offscreen: could not make the context current (EGL error 0x%x)\n", eglGetError());
+        destroy();
+        return false;
+    }
+
+    if (!pbuffer && !create_framebuffer()) {
+        destroy();
+        return false;
+    }
+
+    log("offscreen: %s, %s on %s\n", pbuffer ? "pbuffer" : "surfaceless",
+            (const char *)glGetString(GL_VERSION), (const char *)glGetString(GL_RENDERER));
+    return true;
+}
+
+bool OffscreenContext::create_framebuffer() {
+    // the entry points are needed before the app loads them
+    load_gl_extensions(get_proc_address);
+    if (!glext.framebuffer_object) {
+        log("offscreen: surfaceless contexts need framebuffer objects\n");
+        return false;
+    }
+
+    glext.GenRenderbuffers(2, renderbuffers);
+    glext.BindRenderbuffer(GL_RENDERBUFFER, renderbuffers[0]);
+    glext.RenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glext.BindRenderbuffer(GL_RENDERBUFFER, renderbuffers[1]);
+    glext.RenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+    glext.BindRenderbuffer(GL_RENDERBUFFER, 0);
+
+    glext.GenFramebuffers(1, &framebuffer);
+    glext.BindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    glext.FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, renderbuffers[0]);
+    glext.FramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, renderbuffers[1]);
+    if (glext.CheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        log("offscreen: incomplete framebuffer\n");
+        return false;
+    }
+
+    // without a default framebuffer, draw and read the renderbuffer instead
+    glDrawBuffer(GL_COLOR_ATTACHMENT0);
+    glReadBuffer(GL_COLOR_ATTACHMENT0);
+    return true;
+}
+
+void OffscreenContext::destroy() {
+    if (!display) {
+        return;
+    }
+    if (framebuffer) {
+        glext.DeleteFramebuffers(1, &framebuffer);
+        glext.DeleteRenderbuffers(2, renderbuffers);
+        framebuffer = 0;
+    }
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    if (surface) {
+        eglDestroySurface(display, surface);
+    }
+    if (context) {
+        eglDestroyContext(display, context);
+    }
+    eglTerminate(display);
+    display = surface = context = NULL;
+}
+
+GLProc OffscreenContext::get_proc_address(const char *name) {
+    return (GLProc)eglGetProcAddress(name);
+}
+
+#else
+
+bool OffscreenContext::create(int width, int height) {
+    log("offscreen rendering needs EGL, which this build doesn't have\n");
+    return false;
+}
+
+void OffscreenContext::destroy() {}
+
+GLProc OffscreenContext::get_proc_address(const char *name) {
+    return NULL;
+}
+
+#endif // OCEAN_HAS_EGL
+
+OffscreenContext::~OffscreenContext() {
+    destroy();
+}
+
+void OffscreenContext::read_pixels(unsigned char *rgb) {
+    std::vector<unsigned char> rows((size_t)width * height * 3);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, &rows[0]);
+
+    // GL returns the bottom row first
+    size_t stride = (size_t)width * 3;
+    for (int y=0; y<height; y++) {
+        memcpy(rgb + y * stride, &rows[(size_t)(height - 1 - y) * stride], stride);
+    }
+}
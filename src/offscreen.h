@@ -0,0 +1,47 @@
+#ifndef OFFSCREEN_H
+#define OFFSCREEN_H
+
+#include "gl_ext.h"
+
+// a GL context without a window, created through EGL so it works on machines
+// without a display server (Mesa's llvmpipe included). rendering goes to a
+// pbuffer, or to a framebuffer object when the driver only offers surfaceless
+// contexts. only available when built with OCEAN_HAS_EGL
+class OffscreenContext {
+    private:
+        // EGL handles, kept opaque so users don't need the EGL headers
+        void *display = NULL;
+        void *surface = NULL;
+        void *context = NULL;
+
+        // framebuffer object of surfaceless contexts, 0 with a pbuffer
+        GLuint framebuffer = 0;
+        GLuint renderbuffers[2] = { 0, 0 };
+
+        int width = 0, height = 0;
+
+        bool create_framebuffer();
+
+    public:
+        OffscreenContext() {}
+        ~OffscreenContext();
+
+        OffscreenContext(const OffscreenContext &) = delete;
+        OffscreenContext &operator=(const OffscreenContext &) = delete;
+
+        // create a compatibility profile context with a width x height color
+        // and depth buffer and make it current, false if EGL can't provide one
+        bool create(int width, int height);
+        void destroy();
+
+        int get_width() { return width; }
+        int get_height() { return height; }
+
+        // read the finished frame as tightly packed RGB rows, top row first
+        void read_pixels(unsigned char *rgb);
+
+        // eglGetProcAddress, for load_gl_extensions
+        static GLProc get_proc_address(const char *name);
+};
+
+#endif // OFFSCREEN_H
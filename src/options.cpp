@@ -0,0 +1,138 @@
+#include "options.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void print_usage(const char *program) {
+    fprintf(stderr,
+        "usage: %s [options]\n"
+        "  --verify-gpu-noise          compare compute shader noise with the CPU and exit\n"
+        "  --verify-ocean              check the FFT ocean's wave direction and displacement and exit\n"
+        "  --fps <rate>                frame rate cap, 0 for uncapped (default 60)\n"
+        "  --sim-rate <rate>           fixed simulation steps per second (default 60)\n"
+        "  --max-sim-steps <n>         simulation steps per frame before dropping time (default 5)\n"
+        "  --no-vsync                  always pace frames by sleeping, never with the swap interval\n"
+        "  --frame-stats               report frame intervals and pacing jitter\n"
+        "  --report-interval <seconds> time between periodic reports (default 5)\n"
+        "  --profile                   report CPU time per zone (update, draw, swap, ...)\n"
+        "  --trace <path>              record a Chrome trace of the CPU zones, written at exit and on F12\n"
+        "  --gpu-timing [seconds]      report per pass GPU times, optionally setting the interval\n"
+        "  --gpu-timing-file <path>    write the final GPU timing report to path\n"
+        "  --gl-state-stats            print redundant GL state changes skipped at exit\n"
+        "  --offscreen <frames>        render frames along a scripted camera path without a window\n"
+        "                              (EGL), report their timings and exit\n"
+        "  --size <width> <height>     offscreen framebuffer size (default 800 600)\n"
+        "  --dump <path>               write the last offscreen frame as .ppm or .png\n"
+        "  --record <path>             save the camera at every simulation step to path at exit\n"
+        "  --replay <path|name>        replay a recorded camera path or a built-in one (orbit,\n"
+        "                              flyover, zoom) one step per frame, then exit\n"
+        "  --replay-steps <n>          steps of the built-in paths (default 600)\n"
+        "  --frame-times <path>        write every replayed frame's time in ms to path\n"
+        "  --capture <pattern>         save frames as images named by a printf pattern, e.g.\n"
+        "                              frames/%%05d.png (.png, .ppm or .raw)\n"
+        "  --capture-frames <n>        stop capturing after n frames (default no limit)\n"
+        "  --ocean <size>              animate the surface with an FFT ocean of size x size\n"
+        "                              waves, a power of two from 64 to 1024\n"
+        "  --ocean-loop <path>         play back an ocean loop baked by Ocean-breeze-ocean-bake\n"
+        "  --waves <path>              load the Gerstner wave bank from path\n"
+        "  --help                      show this message\n",
+        program);
+}
+
+// the value after argv[i] as a number, or fallback if there isn't one
+static double optional_number(int argc, char **argv, int &i, double fallback) {
+    if (i + 1 < argc) {
+        char *end;
+        double value = strtod(argv[i+1], &end);
+        if (end != argv[i+1] && *end == '\0') {
+            i++;
+            return value;
+        }
+    }
+    return fallback;
+}
+
+bool parse_options(int argc, char **argv, Options &options) {
+    for (int i=1; i<argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--verify-gpu-noise") == 0) {
+            options.verify_gpu_noise = true;
+        } else if (strcmp(arg, "--verify-ocean") == 0) {
+            options.verify_ocean = true;
+        } else if (strcmp(arg, "--gpu-timing") == 0) {
+            options.gpu_timing = true;
+            options.report_interval = optional_number(argc, argv, i, options.report_interval);
+        } else if (strcmp(arg, "--gpu-timing-file") == 0 && i + 1 < argc) {
+            options.gpu_timing = true;
+            options.gpu_timing_file = argv[++i];
+        } else if (strcmp(arg, "--fps") == 0 && i + 1 < argc) {
+            options.frame_rate = atof(argv[++i]);
+        } else if (strcmp(arg, "--sim-rate") == 0 && i + 1 < argc) {
+            options.sim_rate = atof(argv[++i]);
+        } else if (strcmp(arg, "--max-sim-steps") == 0 && i + 1 < argc) {
+            options.max_sim_steps = atoi(argv[++i]);
+        } else if (strcmp(arg, "--no-vsync") == 0) {
+            options.vsync = false;
+        } else if (strcmp(arg, "--frame-stats") == 0) {
+            options.frame_stats = true;
+        } else if (strcmp(arg, "--report-interval") == 0 && i + 1 < argc) {
+            options.report_interval = atof(argv[++i]);
+        } else if (strcmp(arg, "--profile") == 0) {
+            options.profile = true;
+        } else if (strcmp(arg, "--trace") == 0 && i + 1 < argc) {
+            options.trace_file = argv[++i];
+        } else if (strcmp(arg, "--gl-state-stats") == 0) {
+            options.gl_state_stats = true;
+        } else if (strcmp(arg, "--offscreen") == 0 && i + 1 < argc) {
+            options.offscreen = true;
+            options.offscreen_frames = atoi(argv[++i]);
+        } else if (strcmp(arg, "--size") == 0 && i + 2 < argc) {
+            options.offscreen_width = atoi(argv[++i]);
+            options.offscreen_height = atoi(argv[++i]);
+        } else if (strcmp(arg, "--dump") == 0 && i + 1 < argc) {
+            options.dump_file = argv[++i];
+        } else if (strcmp(arg, "--record") == 0 && i + 1 < argc) {
+            options.record_file = argv[++i];
+        } else if (strcmp(arg, "--replay") == 0 && i + 1 < argc) {
+            options.replay = argv[++i];
+        } else if (strcmp(arg, "--replay-steps") == 0 && i + 1 < argc) {
+            options.replay_steps = atoi(argv[++i]);
+        } else if (strcmp(arg, "--frame-times") == 0 && i + 1 < argc) {
+            options.frame_times_file = argv[++i];
+        } else if (strcmp(arg, "--capture") == 0 && i + 1 < argc) {
+            options.capture_pattern = argv[++i];
+        } else if (strcmp(arg, "--capture-frames") == 0 && i + 1 < argc) {
+            options.capture_frames = atoi(argv[++i]);
+        } else if (strcmp(arg, "--ocean") == 0 && i + 1 < argc) {
+            options.ocean_size = atoi(argv[++i]);
+        } else if (strcmp(arg, "--ocean-loop") == 0 && i + 1 < argc) {
+            options.ocean_loop_file = argv[++i];
+        } else if (strcmp(arg, "--waves") == 0 && i + 1 < argc) {
+            options.waves_file = argv[++i];
+        } else {
+            if (strcmp(arg, "--help") != 0) {
+                fprintf(stderr, "unknown argument %s\n", arg);
+            }
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+    if (options.sim_rate <= 0 || options.max_sim_steps < 1) {
+        fprintf(stderr, "the simulation needs a positive rate and at least one step per frame\n");
+        return false;
+    }
+    if (options.replay_steps < 1) {
+        fprintf(stderr, "built-in camera paths need at least one step\n");
+        return false;
+    }
+    if (options.offscreen_width <= 0 || options.offscreen_height <= 0) {
+        fprintf(stderr, "the offscreen framebuffer needs a positive size\n");
+        return false;
+    }
+    int ocean = options.ocean_size;
+    if (ocean && (ocean < 64 || ocean > 1024 || (ocean & (ocean - 1)) != 0)) {
+        fprintf(stderr, "the ocean size must be a power of two from 64 to 1024\n");
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,78 @@
+#ifndef OPTIONS_H
+#define OPTIONS_H
+
+#include <string>
+
+// command line options of the application
+struct Options {
+    // compare the compute shader noise against the CPU and quit
+    bool verify_gpu_noise = false;
+    // check that the FFT ocean's waves travel downwind and sharpen, then quit
+    bool verify_ocean = false;
+
+    // seconds between the periodic timing reports
+    double report_interval = 5.0;
+
+    // simulation steps per second, independent of the frame rate
+    double sim_rate = 60;
+    // steps a single frame may run before dropping time
+    int max_sim_steps = 5;
+
+    // frames per second, 0 for uncapped
+    double frame_rate = 60;
+    // let the display pace frames when its refresh rate matches frame_rate
+    bool vsync = true;
+    // report frame intervals and pacing jitter
+    bool frame_stats = false;
+
+    // time CPU zones (update, draw, swap, ...)
+    bool profile = false;
+
+    // record a timeline of the CPU zones and write it here as Chrome trace JSON
+    std::string trace_file;
+
+    // time the GPU passes
+    bool gpu_timing = false;
+    // where the final GPU timing report goes, stderr if empty
+    std::string gpu_timing_file;
+
+    // print how many GL state changes were issued and skipped at exit
+    bool gl_state_stats = false;
+
+    // render without a window through EGL, frames along a scripted camera
+    // path, then quit. --verify-gpu-noise also runs in this context
+    bool offscreen = false;
+    int offscreen_frames = 0;
+    // size of the offscreen framebuffer
+    int offscreen_width = 800, offscreen_height = 600;
+    // write the last offscreen frame here (.ppm or .png)
+    std::string dump_file;
+
+    // save the camera at every simulation step here at exit
+    std::string record_file;
+    // replay a recorded camera path, or orbit, flyover or zoom, one step per
+    // frame, then quit
+    std::string replay;
+    // length of the built-in paths
+    int replay_steps = 600;
+    // write the time of every replayed frame here, one per line in ms
+    std::string frame_times_file;
+
+    // save frames to files named by this printf pattern (.png, .ppm or .raw)
+    std::string capture_pattern;
+    // stop capturing after this many frames, 0 for no limit
+    int capture_frames = 0;
+
+    // waves per side of the FFT ocean, 0 for the Gerstner waves
+    int ocean_size = 0;
+    // play back this baked ocean loop, in place of the FFT ocean
+    std::string ocean_loop_file;
+    // load the Gerstner wave bank from this file instead of the single
+    // default wave
+    std::string waves_file;
+};
+
+// parse argv into options, prints usage and returns false on bad arguments
+bool parse_options(int argc, char **argv, Options &options);
+
+#endif // OPTIONS_H
@@ -1,10 +1,57 @@
 #include "pnoise.h"
+#include "fast_math.h"
+#include <algorithm>
 #include <math.h>
-#include "app.h"
+#include "logger.h"
 
 using namespace Eigen;
 
+// points the warped noise evaluates at a time, its stages keep a few floats
+// per point on the stack
+#define WARP_BLOCK 64
+
+// a second hash from a first, cheaper than hashing the point again
+static inline uint32_t remix_hash(uint32_t h) {
+    h *= 0x9e3779b1u;
+    return h ^ (h >> 16);
+}
+
+// a gradient component in [-scale/2, scale/2] from 16 bits, as get_gradient2D
+static inline float gradient_component(uint32_t bits, float scale) {
+    return (bits * (1.0f/65535.0f)) * scale - scale/2;
+}
+
+// the noise at (fx, fy) in a cell from the gradients at its corners, bottom
+// left, bottom right, top left and top right, and its partial derivatives
+static inline float blend_corners(float fx, float fy,
+        float blx, float bly, float brx, float bry, float tlx, float tly, float trx, float try_,
+        float &dx, float &dy) {
+    float s = blx*fx + bly*fy;
+    float t = brx*(fx - 1) + bry*fy;
+    float u = tlx*fx + tly*(fy - 1);
+    float v = trx*(fx - 1) + try_*(fy - 1);
+
+    float Sx = fx*fx*(3 - 2*fx);
+    float Sy = fy*fy*(3 - 2*fy);
+    float dSx = 6*fx*(1 - fx);
+    float dSy = 6*fy*(1 - fy);
+
+    float a = s + Sx*(t - s);
+    float b = u + Sx*(v - u);
+    float dax = blx + Sx*(brx - blx) + dSx*(t - s);
+    float day = bly + Sx*(bry - bly);
+    float dbx = tlx + Sx*(trx - tlx) + dSx*(v - u);
+    float dby = tly + Sx*(try_ - tly);
+    dx = dax + Sy*(dbx - dax);
+    dy = day + Sy*(dby - day) + dSy*(b - a);
+    return a + Sy*(b - a);
+}
+
 float PNoise::get_height2D(float x, float y) {
+    // the lattice is one wavelength apart
+    x /= wavelength;
+    y /= wavelength;
+
     // the four points around the point x, y
     int x0, x1, y0, y1;
 
@@ -33,7 +80,8 @@ float PNoise::get_height2D(float x, float y) {
 
     // we use the easing cure 3p^2 - 2p^3
     // Sx is the weighted average for x components, we use it on s and t since they have the same x
-    float Sx = 3*pow((x - x0), 2) - 2*pow((x - x0), 3);
+    float fx = x - x0;
+    float Sx = fx*fx*(3 - 2*fx);
     // a is the final weighted value after averaging s and t
     float a = s + Sx*(t - s);
     // b is the final weighted value after averaging u and v
@@ -42,7 +90,8 @@ float PNoise::get_height2D(float x, float y) {
     //log("Sx: %g, %g, %g\n", Sx, a, b);
 
     // now we find our weighted average for y components
-    float Sy = 3*pow((y - y0), 2) - 2*pow((y - y0), 3);
+    float fy = y - y0;
+    float Sy = fy*fy*(3 - 2*fy);
     // find weighted average of a and b
     float z = a + Sy*(b - a);
 
@@ -51,18 +100,169 @@ float PNoise::get_height2D(float x, float y) {
     return z;
 }
 
+float PNoise::get_height_gradient2D(float x, float y, Vector2f &gradient) {
+    // same construction as get_height2D, differentiated term by term
+    x /= wavelength;
+    y /= wavelength;
+
+    int x0 = (int)floor(x);
+    int y0 = (int)floor(y);
+    int x1 = x0 + 1;
+    int y1 = y0 + 1;
+
+    Vector2f tl = get_gradient2D(x0, y1);
+    Vector2f tr = get_gradient2D(x1, y1);
+    Vector2f bl = get_gradient2D(x0, y0);
+    Vector2f br = get_gradient2D(x1, y0);
+
+    float s = bl.dot(Vector2f(x, y) - Vector2f(x0, y0));
+    float t = br.dot(Vector2f(x, y) - Vector2f(x1, y0));
+    float u = tl.dot(Vector2f(x, y) - Vector2f(x0, y1));
+    float v = tr.dot(Vector2f(x, y) - Vector2f(x1, y1));
+
+    float fx = x - x0;
+    float fy = y - y0;
+    float Sx = fx*fx*(3 - 2*fx);
+    float Sy = fy*fy*(3 - 2*fy);
+    // derivatives of the easing curve, 6p - 6p^2
+    float dSx = 6*fx*(1 - fx);
+    float dSy = 6*fy*(1 - fy);
+
+    float a = s + Sx*(t - s);
+    float b = u + Sx*(v - u);
+
+    // the dot products are linear, their derivatives are the gradients themselves
+    Vector2f da = bl + Sx*(br - bl) + Vector2f(dSx*(t - s), 0);
+    Vector2f db = tl + Sx*(tr - tl) + Vector2f(dSx*(v - u), 0);
+
+    // chain rule through the division by the wavelength
+    gradient = (da + Sy*(db - da) + Vector2f(0, dSy*(b - a))) / wavelength;
+    return a + Sy*(b - a);
+}
+
 Vector2f PNoise::get_gradient2D(int x, int y) {
-    // seed is the same given the same x and y
-    float seed = 1234567*x + 4321*y;
-    srand(seed);
+    // hashing keeps the gradient the same given the same x and y, without the
+    // global state of srand/rand so it is safe to call from several threads
+    uint32_t h = hash2D(x, y, seed);
 
-    // x0 and x1 are floats between [0, amplitude)
-    float x0 = (((float)rand() / RAND_MAX) * amplitude) - (amplitude/2);
-    float x1 = (((float)rand() / RAND_MAX) * amplitude) - (amplitude/2);
+    // x0 and x1 are floats between [-amplitude/2, amplitude/2]
+    float x0 = ((h & 0xffff) * (1.0f/65535.0f)) * amplitude - (amplitude/2);
+    float x1 = ((h >> 16) * (1.0f/65535.0f)) * amplitude - (amplitude/2);
 
     return Vector2f(x0, x1);
 }
 
+void PNoise::get_heights2D(int count, const float *x, const float *y, float *heights) {
+    const float *__restrict px = x;
+    const float *__restrict py = y;
+    float *__restrict out = heights;
+    // locals, the stores below could otherwise alias the members
+    float scale = amplitude, period = wavelength;
+    uint32_t noise_seed = seed;
+    for (int i=0; i<count; i++) {
+        float u = px[i] / period, v = py[i] / period;
+        int x0 = floor_fast(u), y0 = floor_fast(v);
+        float fx = u - x0, fy = v - y0;
+        uint32_t hbl = hash2D(x0, y0, noise_seed);
+        uint32_t hbr = hash2D(x0 + 1, y0, noise_seed);
+        uint32_t htl = hash2D(x0, y0 + 1, noise_seed);
+        uint32_t htr = hash2D(x0 + 1, y0 + 1, noise_seed);
+        float dx, dy;
+        out[i] = blend_corners(fx, fy,
+                gradient_component(hbl & 0xffff, scale), gradient_component(hbl >> 16, scale),
+                gradient_component(hbr & 0xffff, scale), gradient_component(hbr >> 16, scale),
+                gradient_component(htl & 0xffff, scale), gradient_component(htl >> 16, scale),
+                gradient_component(htr & 0xffff, scale), gradient_component(htr >> 16, scale), dx, dy);
+    }
+}
+
+void PNoise::get_warped_heights2D(int count, const float *x, const float *y,
+        float *heights, float *gradient_x, float *gradient_y) {
+    // the warp fields get their own seed so they don't follow the noise
+    uint32_t warp_seed = seed ^ 0x5bd1e995u;
+    float warp_scale = 1 / warp_wavelength;
+    // locals, the stores below could otherwise alias the members
+    float strength = warp_strength;
+    float scale = amplitude, period = wavelength;
+    uint32_t noise_seed = seed;
+
+    for (int first=0; first<count; first+=WARP_BLOCK) {
+        int n = std::min(count - first, WARP_BLOCK);
+        const float *__restrict bx = x + first;
+        const float *__restrict by = y + first;
+        // the warped points and the derivatives of the warp
+        float px[WARP_BLOCK], py[WARP_BLOCK];
+        float jxx[WARP_BLOCK], jxy[WARP_BLOCK], jyx[WARP_BLOCK], jyy[WARP_BLOCK];
+
+        // both warp fields from one pass over the warp lattice, the second
+        // field's gradients remix the first's hashes
+        for (int i=0; i<n; i++) {
+            float u = bx[i]*warp_scale, v = by[i]*warp_scale;
+            int x0 = floor_fast(u), y0 = floor_fast(v);
+            float fx = u - x0, fy = v - y0;
+            uint32_t hbl = hash2D(x0, y0, warp_seed);
+            uint32_t hbr = hash2D(x0 + 1, y0, warp_seed);
+            uint32_t htl = hash2D(x0, y0 + 1, warp_seed);
+            uint32_t htr = hash2D(x0 + 1, y0 + 1, warp_seed);
+            float wxx, wxy, wyx, wyy;
+            float wx = blend_corners(fx, fy,
+                    gradient_component(hbl & 0xffff, 1), gradient_component(hbl >> 16, 1),
+                    gradient_component(hbr & 0xffff, 1), gradient_component(hbr >> 16, 1),
+                    gradient_component(htl & 0xffff, 1), gradient_component(htl >> 16, 1),
+                    gradient_component(htr & 0xffff, 1), gradient_component(htr >> 16, 1), wxx, wxy);
+            hbl = remix_hash(hbl);
+            hbr = remix_hash(hbr);
+            htl = remix_hash(htl);
+            htr = remix_hash(htr);
+            float wy = blend_corners(fx, fy,
+                    gradient_component(hbl & 0xffff, 1), gradient_component(hbl >> 16, 1),
+                    gradient_component(hbr & 0xffff, 1), gradient_component(hbr >> 16, 1),
+                    gradient_component(htl & 0xffff, 1), gradient_component(htl >> 16, 1),
+                    gradient_component(htr & 0xffff, 1), gradient_component(htr >> 16, 1), wyx, wyy);
+            px[i] = bx[i] + strength*wx;
+            py[i] = by[i] + strength*wy;
+            // the derivatives of p + strength*w, through the division by
+            // the warp wavelength
+            float d = strength*warp_scale;
+            jxx[i] = 1 + d*wxx;
+            jxy[i] = d*wxy;
+            jyx[i] = d*wyx;
+            jyy[i] = 1 + d*wyy;
+        }
+
+        float *__restrict out = heights + first;
+        for (int i=0; i<n; i++) {
+            float u = px[i] / period, v = py[i] / period;
+            int x0 = floor_fast(u), y0 = floor_fast(v);
+            float fx = u - x0, fy = v - y0;
+            uint32_t hbl = hash2D(x0, y0, noise_seed);
+            uint32_t hbr = hash2D(x0 + 1, y0, noise_seed);
+            uint32_t htl = hash2D(x0, y0 + 1, noise_seed);
+            uint32_t htr = hash2D(x0 + 1, y0 + 1, noise_seed);
+            float nx, ny;
+            out[i] = blend_corners(fx, fy,
+                    gradient_component(hbl & 0xffff, scale), gradient_component(hbl >> 16, scale),
+                    gradient_component(hbr & 0xffff, scale), gradient_component(hbr >> 16, scale),
+                    gradient_component(htl & 0xffff, scale), gradient_component(htl >> 16, scale),
+                    gradient_component(htr & 0xffff, scale), gradient_component(htr >> 16, scale), nx, ny);
+            // chain rule through the warp: the noise gradient times its jacobian
+            px[i] = (nx*jxx[i] + ny*jyx[i]) / period;
+            py[i] = (nx*jxy[i] + ny*jyy[i]) / period;
+        }
+
+        if (gradient_x) {
+            std::copy(px, px + n, gradient_x + first);
+            std::copy(py, py + n, gradient_y + first);
+        }
+    }
+}
+
+float PNoise::get_warped_height2D(float x, float y) {
+    float height;
+    get_warped_heights2D(1, &x, &y, &height);
+    return height;
+}
+
 // getters
 float PNoise::get_amplitude() {
     return amplitude;
@@ -72,6 +272,18 @@ float PNoise::get_wavelength() {
     return wavelength;
 }
 
+uint32_t PNoise::get_seed() {
+    return seed;
+}
+
+float PNoise::get_warp_strength() {
+    return warp_strength;
+}
+
+float PNoise::get_warp_wavelength() {
+    return warp_wavelength;
+}
+
 // setters
 void PNoise::set_amplitude(float amp) {
     amplitude = amp;
@@ -80,3 +292,12 @@ void PNoise::set_amplitude(float amp) {
 void PNoise::set_wavelength(float wav) {
     wavelength = wav;
 }
+
+void PNoise::set_seed(uint32_t s) {
+    seed = s;
+}
+
+void PNoise::set_warp(float strength, float wavelength) {
+    warp_strength = strength;
+    warp_wavelength = wavelength;
+}
@@ -2,27 +2,68 @@
 #define PERLIN_NOISE_H
 
 #include <Eigen/Core>
+#include <stddef.h>
+#include <stdint.h>
 
 class PNoise {
     private:
-        float amplitude, wavelength;
+        // wavelength is the distance between lattice points in world units
+        float amplitude = 1.0f, wavelength = 1.0f;
+        uint32_t seed = 0;
+        // domain warping, off at strength 0: the point is moved by
+        // warp_strength times two more noise fields, of amplitude 1 and
+        // warp_wavelength, before the noise is sampled
+        float warp_strength = 0.0f, warp_wavelength = 1.0f;
 
     public:
         // getters
         float get_amplitude();
         float get_wavelength();
+        uint32_t get_seed();
+        float get_warp_strength();
+        float get_warp_wavelength();
 
         // setters
         void set_amplitude(float amp);
         void set_wavelength(float wav);
+        void set_seed(uint32_t s);
+        void set_warp(float strength, float wavelength);
 
         // 2D - functions
         float get_height2D(float x, float y);
+        // height and its analytic partial derivatives (dz/dx, dz/dy)
+        float get_height_gradient2D(float x, float y, Eigen::Vector2f &gradient);
         Eigen::Vector2f get_gradient2D(int x, int y);
 
+        // the noise at count points in one pass that vectorizes, the same
+        // heights as get_height2D to rounding
+        void get_heights2D(int count, const float *x, const float *y, float *heights);
+        // the warped noise at count points and, unless gradient_x is NULL,
+        // its partial derivatives. the two warp fields share the lattice
+        // cell, hash and easing of every point, and the points run in
+        // blocks so both stages vectorize. 0 strength gives the plain noise
+        void get_warped_heights2D(int count, const float *x, const float *y,
+                float *heights, float *gradient_x = NULL, float *gradient_y = NULL);
+        // same, for a single point
+        float get_warped_height2D(float x, float y);
+
         // constructor
         PNoise() {}
 
 };
 
+// integer hash of a lattice point, shared with the noise compute shader.
+// inline so the batched evaluators vectorize over it
+inline uint32_t hash2D(int x, int y, uint32_t seed) {
+    // combine the coordinates then run a lowbias32 finalizer over them so
+    // neighbouring points don't end up with correlated gradients
+    uint32_t h = (uint32_t)x*0x8da6b343u ^ (uint32_t)y*0xd8163841u ^ seed*0xcb1ab31fu;
+    h ^= h >> 16;
+    h *= 0x7feb352du;
+    h ^= h >> 15;
+    h *= 0x846ca68bu;
+    h ^= h >> 16;
+    return h;
+}
+
 #endif // PERLIN_NOISE_H
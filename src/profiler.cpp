@@ -0,0 +1,131 @@
+#include "profiler.h"
+#include <chrono>
+
+Profiler profiler;
+
+static thread_local ZoneBuffer *local_buffer = NULL;
+
+void ZoneBuffer::push(const ZoneEvent &event) {
+    uint32_t h = head.load(std::memory_order_relaxed);
+    uint32_t next = (h + 1) % PROFILER_BUFFER_SIZE;
+    if (next == tail.load(std::memory_order_acquire)) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    events[h] = event;
+    head.store(next, std::memory_order_release);
+}
+
+bool ZoneBuffer::pop(ZoneEvent &event) {
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if (t == head.load(std::memory_order_acquire)) {
+        return false;
+    }
+    event = events[t];
+    tail.store((t + 1) % PROFILER_BUFFER_SIZE, std::memory_order_release);
+    return true;
+}
+
+uint64_t Profiler::now() {
+    using namespace std::chrono;
+    static const steady_clock::time_point start = steady_clock::now();
+    return duration_cast<nanoseconds>(steady_clock::now() - start).count();
+}
+
+uint32_t Profiler::zone_id(const char *name) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    for (size_t i=0; i<zones.size(); i++) {
+        if (zones[i]->name == name) {
+            return i;
+        }
+    }
+    zones.push_back(new Zone(name));
+    return zones.size() - 1;
+}
+
+const std::string &Profiler::zone_name(uint32_t id) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    return zones[id]->name;
+}
+
+ZoneBuffer *Profiler::register_thread() {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    // buffers outlive their threads so late events can still be collected
+    ZoneBuffer *buffer = new ZoneBuffer(buffers.size());
+    buffer->thread_name = buffers.empty() ? "main" : "thread " + std::to_string(buffers.size());
+    buffers.push_back(buffer);
+    return buffer;
+}
+
+ZoneBuffer *Profiler::thread_buffer() {
+    if (!local_buffer) {
+        local_buffer = register_thread();
+    }
+    return local_buffer;
+}
+
+void Profiler::set_thread_name(const char *name) {
+    ZoneBuffer *buffer = thread_buffer();
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    buffer->thread_name = name;
+}
+
+void Profiler::record(uint32_t zone, uint64_t begin_ns, uint64_t end_ns) {
+    ZoneEvent event;
+    event.zone = zone;
+    event.begin_ns = begin_ns;
+    event.end_ns = end_ns;
+    thread_buffer()->push(event);
+}
+
+void Profiler::collect(void (*sink)(const ZoneBuffer &buffer, const ZoneEvent &event)) {
+    // copy the lists so the registry lock isn't held while draining
+    std::vector<ZoneBuffer *> threads;
+    std::vector<Zone *> known_zones;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        threads = buffers;
+        known_zones = zones;
+    }
+
+    for (size_t i=0; i<threads.size(); i++) {
+        ZoneEvent event;
+        while (threads[i]->pop(event)) {
+            if (event.zone >= known_zones.size()) {
+                // registered after we copied the list
+                std::lock_guard<std::mutex> lock(registry_mutex);
+                known_zones = zones;
+            }
+            known_zones[event.zone]->samples.add((event.end_ns - event.begin_ns) / 1e6);
+            if (sink) {
+                sink(*threads[i], event);
+            }
+        }
+    }
+}
+
+void Profiler::report(FILE *file) {
+    std::vector<Zone *> known_zones;
+    std::vector<ZoneBuffer *> threads;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        known_zones = zones;
+        threads = buffers;
+    }
+
+    fprintf(file, "%-16s %8s %10s %10s %10s %10s\n", "cpu zone", "samples", "min ms", "avg ms", "p50 ms", "p99 ms");
+    for (size_t i=0; i<known_zones.size(); i++) {
+        StatsSummary stats = known_zones[i]->samples.summarize();
+        if (stats.count == 0) {
+            continue;
+        }
+        fprintf(file, "%-16s %8zu %10.3f %10.3f %10.3f %10.3f\n", known_zones[i]->name.c_str(),
+                stats.count, stats.min, stats.avg, stats.p50, stats.p99);
+    }
+    for (size_t i=0; i<threads.size(); i++) {
+        uint32_t dropped = threads[i]->dropped.load(std::memory_order_relaxed);
+        if (dropped > 0) {
+            fprintf(file, "(%u zones dropped on %s, collect more often)\n", dropped, threads[i]->thread_name.c_str());
+        }
+    }
+}
@@ -0,0 +1,125 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include "rolling_stats.h"
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// completed zones a thread can hold before the main thread collects them,
+// zones beyond that are dropped and counted
+#define PROFILER_BUFFER_SIZE 4096
+
+// one timed scope
+struct ZoneEvent {
+    uint32_t zone;
+    uint64_t begin_ns, end_ns;
+};
+
+// single producer, single consumer ring of a thread's completed zones. the
+// owning thread pushes, the collecting thread pops, neither takes a lock
+class ZoneBuffer {
+    private:
+        ZoneEvent events[PROFILER_BUFFER_SIZE];
+        std::atomic<uint32_t> head, tail;
+
+    public:
+        std::string thread_name;
+        uint32_t thread_index;
+        std::atomic<uint32_t> dropped;
+
+        ZoneBuffer(uint32_t index): head(0), tail(0), thread_index(index), dropped(0) {}
+
+        // owning thread only
+        void push(const ZoneEvent &event);
+        // collecting thread only, false when empty
+        bool pop(ZoneEvent &event);
+};
+
+// aggregates timed zones from every thread into rolling statistics. zones
+// cost a branch on an atomic flag when the profiler is disabled, and
+// nothing at all when built with OCEAN_NO_PROFILE
+class Profiler {
+    private:
+        struct Zone {
+            std::string name;
+            // milliseconds per occurrence
+            RollingStats samples;
+
+            Zone(const char *name): name(name) {}
+        };
+
+        std::atomic<bool> enabled;
+        // guards zones and buffers when they grow, never held while timing
+        std::mutex registry_mutex;
+        std::vector<Zone *> zones;
+        std::vector<ZoneBuffer *> buffers;
+
+        ZoneBuffer *register_thread();
+
+    public:
+        Profiler(): enabled(false) {}
+
+        void set_enabled(bool enable) { enabled.store(enable, std::memory_order_relaxed); }
+        bool is_enabled() { return enabled.load(std::memory_order_relaxed); }
+
+        // nanoseconds on the steady clock since the profiler started
+        uint64_t now();
+
+        // id of a named zone, looked up once per call site by PROFILE_ZONE
+        uint32_t zone_id(const char *name);
+        const std::string &zone_name(uint32_t id);
+
+        // the calling thread's buffer, created on first use
+        ZoneBuffer *thread_buffer();
+        // name the calling thread in reports and traces
+        void set_thread_name(const char *name);
+
+        void record(uint32_t zone, uint64_t begin_ns, uint64_t end_ns);
+
+        // drain every thread's buffer into the statistics, call once a frame.
+        // the collected events are also handed to `sink` if given
+        void collect(void (*sink)(const ZoneBuffer &buffer, const ZoneEvent &event) = NULL);
+
+        // min/avg/p50/p99 per zone
+        void report(FILE *file);
+};
+
+extern Profiler profiler;
+
+// times the enclosing scope as the given zone
+class ProfileZone {
+    private:
+        int32_t zone;
+        uint64_t begin_ns = 0;
+
+    public:
+        ProfileZone(uint32_t id) {
+            zone = profiler.is_enabled() ? (int32_t)id : -1;
+            if (zone >= 0) {
+                begin_ns = profiler.now();
+            }
+        }
+        ~ProfileZone() {
+            if (zone >= 0) {
+                profiler.record(zone, begin_ns, profiler.now());
+            }
+        }
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#ifdef OCEAN_NO_PROFILE
+#define PROFILE_ZONE(name)
+#else
+// time the rest of the scope, name must be a string literal
+#define PROFILE_ZONE(name) \
+    static const uint32_t PROFILE_CONCAT(profile_zone_id_, __LINE__) = profiler.zone_id(name); \
+    ProfileZone PROFILE_CONCAT(profile_zone_, __LINE__)(PROFILE_CONCAT(profile_zone_id_, __LINE__))
+#endif
+
+#endif // PROFILER_H
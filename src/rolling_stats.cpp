@@ -0,0 +1,40 @@
+#include "rolling_stats.h"
+#include <algorithm>
+
+void RollingStats::add(double sample) {
+    samples[next] = sample;
+    next = (next + 1) % samples.size();
+    total++;
+}
+
+void RollingStats::clear() {
+    next = 0;
+    total = 0;
+}
+
+size_t RollingStats::get_total() {
+    return total;
+}
+
+StatsSummary RollingStats::summarize() {
+    StatsSummary summary;
+    summary.count = std::min(total, samples.size());
+    if (summary.count == 0) {
+        return summary;
+    }
+
+    // the window isn't in time order once it wrapped, which doesn't matter here
+    std::vector<double> sorted(samples.begin(), samples.begin() + summary.count);
+    std::sort(sorted.begin(), sorted.end());
+
+    double sum = 0;
+    for(size_t i=0; i<sorted.size(); i++) {
+        sum += sorted[i];
+    }
+    summary.min = sorted.front();
+    summary.max = sorted.back();
+    summary.avg = sum / sorted.size();
+    summary.p50 = sorted[(sorted.size() - 1) / 2];
+    summary.p99 = sorted[std::min(sorted.size() - 1, (size_t)(sorted.size() * 0.99))];
+    return summary;
+}
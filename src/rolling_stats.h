@@ -0,0 +1,31 @@
+#ifndef ROLLING_STATS_H
+#define ROLLING_STATS_H
+
+#include <stddef.h>
+#include <vector>
+
+// summary of the samples in a RollingStats window
+struct StatsSummary {
+    size_t count = 0;
+    double min = 0, avg = 0, p50 = 0, p99 = 0, max = 0;
+};
+
+// keeps the last `window` samples of a measurement for percentile reports
+class RollingStats {
+    private:
+        std::vector<double> samples;
+        size_t next = 0;
+        size_t total = 0;
+
+    public:
+        RollingStats(size_t window = 600): samples(window) {}
+
+        void add(double sample);
+        void clear();
+
+        // samples ever added, including those that left the window
+        size_t get_total();
+        StatsSummary summarize();
+};
+
+#endif // ROLLING_STATS_H
@@ -0,0 +1,285 @@
+#include "shader_program.h"
+#include "logger.h"
+#include "gl_state.h"
+#include "profiler.h"
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <direct.h>
+#define make_dir(path) _mkdir(path)
+#else
+#include <sys/stat.h>
+#define make_dir(path) mkdir(path, 0755)
+#endif
+
+// header of a cached program binary, followed by `length` bytes of binary
+struct BinaryHeader {
+    char magic[4];
+    uint32_t format;
+    uint32_t length;
+};
+
+static const char BINARY_MAGIC[4] = { 'O', 'B', 'P', '1' };
+
+// 64-bit FNV-1a, good enough to tell sources apart
+static uint64_t fnv1a(const void *data, size_t size, uint64_t hash = 14695981039346656037ULL) {
+    const unsigned char *bytes = (const unsigned char *)data;
+    for (size_t i=0; i<size; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint64_t fnv1a(const char *str, uint64_t hash) {
+    return str ? fnv1a(str, strlen(str) + 1, hash) : hash;
+}
+
+bool read_file(const std::string &path, std::string &contents) {
+    std::ifstream ifile(path.c_str(), std::ios::in | std::ios::binary);
+    if (!ifile) {
+        return false;
+    }
+    std::ostringstream buffer;
+    buffer << ifile.rdbuf();
+    contents = buffer.str();
+    return true;
+}
+
+void ShaderProgram::add_stage(GLenum type, const std::string &path) {
+    Stage stage;
+    stage.type = type;
+    stage.path = path;
+    stages.push_back(stage);
+}
+
+bool ShaderProgram::build(const std::string &cache_dir) {
+    PROFILE_ZONE("build_program");
+
+    for (size_t i=0; i<stages.size(); i++) {
+        if (!read_file(stages[i].path, stages[i].source)) {
+            log("could not read shader %s\n", stages[i].path.c_str());
+            return false;
+        }
+    }
+
+    if (program) {
+        gl_state.forget_program(program);
+        glDeleteProgram(program);
+    }
+    program = glCreateProgram();
+
+    bool cached = !cache_dir.empty() && glext.program_binary;
+    std::string cache_path = cached ? cache_dir + "/" + cache_key() + ".bin" : "";
+
+    if (cached && load_binary(cache_path)) {
+        log("loaded cached program %s\n", cache_path.c_str());
+    } else {
+        if (cached) {
+            // the hint has to be set before linking for the binary to be retrievable
+            glext.ProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        if (!compile_and_link()) {
+            glDeleteProgram(program);
+            program = 0;
+            return false;
+        }
+        if (cached) {
+            make_dir(cache_dir.c_str());
+            store_binary(cache_path);
+        }
+    }
+
+    cache_uniforms();
+    return true;
+}
+
+std::string ShaderProgram::cache_key() {
+    uint64_t hash = fnv1a("", 0);
+    for (size_t i=0; i<stages.size(); i++) {
+        hash = fnv1a(&stages[i].type, sizeof(stages[i].type), hash);
+        hash = fnv1a(stages[i].source.c_str(), hash);
+    }
+    // binaries are only valid for the driver that produced them
+    hash = fnv1a((const char *)glGetString(GL_VENDOR), hash);
+    hash = fnv1a((const char *)glGetString(GL_RENDERER), hash);
+    hash = fnv1a((const char *)glGetString(GL_VERSION), hash);
+
+    char key[17];
+    snprintf(key, sizeof(key), "%016llx", (unsigned long long)hash);
+    return key;
+}
+
+bool ShaderProgram::load_binary(const std::string &cache_path) {
+    FILE *file = fopen(cache_path.c_str(), "rb");
+    if (!file) {
+        return false;
+    }
+
+    BinaryHeader header;
+    std::vector<char> binary;
+    bool ok = fread(&header, sizeof(header), 1, file) == 1
+        && memcmp(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC)) == 0;
+    if (ok) {
+        binary.resize(header.length);
+        ok = header.length > 0 && fread(&binary[0], 1, header.length, file) == header.length;
+    }
+    fclose(file);
+    if (!ok) {
+        return false;
+    }
+
+    glext.ProgramBinary(program, header.format, &binary[0], header.length);
+
+    // the driver may still reject a binary, e.g. after an update it didn't
+    // report through the version string
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    if (!linked) {
+        log("cached program %s rejected, recompiling\n", cache_path.c_str());
+        remove(cache_path.c_str());
+        glDeleteProgram(program);
+        program = glCreateProgram();
+        return false;
+    }
+    return true;
+}
+
+void ShaderProgram::store_binary(const std::string &cache_path) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    glext.GetProgramBinary(program, length, &length, &format, &binary[0]);
+
+    BinaryHeader header;
+    memcpy(header.magic, BINARY_MAGIC, sizeof(BINARY_MAGIC));
+    header.format = format;
+    header.length = length;
+
+    // write to a temporary and rename so a crash never leaves a torn binary
+    std::string tmp_path = cache_path + ".tmp";
+    FILE *file = fopen(tmp_path.c_str(), "wb");
+    if (!file) {
+        log("could not write program cache %s\n", cache_path.c_str());
+        return;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+        && fwrite(&binary[0], 1, length, file) == (size_t)length;
+    ok &= fclose(file) == 0;
+    remove(cache_path.c_str());
+    if (!ok || rename(tmp_path.c_str(), cache_path.c_str()) != 0) {
+        remove(tmp_path.c_str());
+    }
+}
+
+bool ShaderProgram::compile_and_link() {
+    PROFILE_ZONE("compile_and_link");
+
+    std::vector<GLuint> shaders;
+    bool ok = true;
+
+    for (size_t i=0; i<stages.size() && ok; i++) {
+        GLchar const *source = stages[i].source.c_str();
+        GLint const length = stages[i].source.size();
+
+        GLuint shader = glCreateShader(stages[i].type);
+        glShaderSource(shader, 1, &source, &length);
+        glCompileShader(shader);
+        shaders.push_back(shader);
+
+        GLint compiled = GL_FALSE;
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+        if (!compiled) {
+            GLint max_length = 0;
+            glGetShaderiv(shader, GL_INFO_LOG_LENGTH, &max_length);
+
+            // max_length includes the NULL character
+            std::vector<char> error_log(max_length + 1);
+            glGetShaderInfoLog(shader, max_length, &max_length, &error_log[0]);
+            log("%s failed to compile:\n%s\n", stages[i].path.c_str(), &error_log[0]);
+            ok = false;
+        } else {
+            glAttachShader(program, shader);
+        }
+    }
+
+    if (ok) {
+        glLinkProgram(program);
+
+        GLint linked = GL_FALSE;
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (!linked) {
+            GLint max_length = 0;
+            glGetProgramiv(program, GL_INFO_LOG_LENGTH, &max_length);
+
+            std::vector<GLchar> info_log(max_length + 1);
+            glGetProgramInfoLog(program, max_length, &max_length, &info_log[0]);
+            log("shaders not linked:\n%s\n", &info_log[0]);
+            ok = false;
+        }
+    }
+
+    // the linked program keeps what it needs, don't leak the shaders
+    for (size_t i=0; i<shaders.size(); i++) {
+        if (ok) {
+            glDetachShader(program, shaders[i]);
+        }
+        glDeleteShader(shaders[i]);
+    }
+    return ok;
+}
+
+void ShaderProgram::cache_uniforms() {
+    uniforms.clear();
+
+    GLint count = 0, max_length = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &max_length);
+
+    std::vector<GLchar> name(max_length + 1);
+    for (GLint i=0; i<count; i++) {
+        GLsizei length = 0;
+        GLint size = 0;
+        GLenum type = 0;
+        glGetActiveUniform(program, i, name.size(), &length, &size, &type, &name[0]);
+
+        std::string uniform_name(&name[0], length);
+        GLint location = glGetUniformLocation(program, uniform_name.c_str());
+        if (location < 0) {
+            // built-in gl_ state isn't addressable by location
+            continue;
+        }
+        uniforms[uniform_name] = location;
+
+        // arrays are reported as "name[0]", allow looking them up as "name" too
+        size_t bracket = uniform_name.find("[0]");
+        if (bracket != std::string::npos) {
+            uniforms[uniform_name.substr(0, bracket)] = location;
+        }
+    }
+}
+
+void ShaderProgram::use() {
+    gl_state.use_program(program);
+}
+
+GLint ShaderProgram::uniform(const std::string &name) {
+    std::map<std::string, GLint>::iterator it = uniforms.find(name);
+    return it == uniforms.end() ? -1 : it->second;
+}
+
+GLuint ShaderProgram::get_id() {
+    return program;
+}
+
+bool ShaderProgram::is_linked() {
+    return program != 0;
+}
@@ -0,0 +1,64 @@
+#ifndef SHADER_PROGRAM_H
+#define SHADER_PROGRAM_H
+
+#include "gl_ext.h"
+#include <map>
+#include <string>
+#include <vector>
+
+// linked shader programs are cached here between launches
+#define SHADER_CACHE_DIR ".shader_cache"
+
+// a linked GLSL program built from shader files, with every active uniform
+// location looked up once at link time. when the driver supports it the
+// linked binary is stored on disk and reused on the next launch
+class ShaderProgram {
+    private:
+        struct Stage {
+            GLenum type;
+            std::string path;
+            std::string source;
+        };
+
+        GLuint program = 0;
+        std::vector<Stage> stages;
+        std::map<std::string, GLint> uniforms;
+
+        // hash of the stage sources and the driver that compiled them
+        std::string cache_key();
+        bool load_binary(const std::string &cache_path);
+        void store_binary(const std::string &cache_path);
+
+        bool compile_and_link();
+        void cache_uniforms();
+
+    public:
+        // the program object lives as long as the GL context, which usually
+        // outlives the globals holding programs, so it is never deleted here
+        ShaderProgram() {}
+
+        // non-copyable, the program object is owned
+        ShaderProgram(const ShaderProgram &) = delete;
+        ShaderProgram &operator=(const ShaderProgram &) = delete;
+
+        // add a stage (GL_VERTEX_SHADER, ...) whose source is read from path
+        void add_stage(GLenum type, const std::string &path);
+
+        // read the sources and link the program, trying the binary cache in
+        // cache_dir first (pass "" to disable caching), false on failure
+        bool build(const std::string &cache_dir);
+
+        // make this the current program
+        void use();
+
+        // location of the named uniform, -1 if it isn't active
+        GLint uniform(const std::string &name);
+
+        GLuint get_id();
+        bool is_linked();
+};
+
+// read a whole file into a string, false if it can't be opened
+bool read_file(const std::string &path, std::string &contents);
+
+#endif // SHADER_PROGRAM_H
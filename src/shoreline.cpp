@@ -0,0 +1,201 @@
+#include "shoreline.h"
+#include "profiler.h"
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+// seed position of points with no crossing found yet, far enough that any
+// real crossing is closer and close enough that its square stays finite
+#define SHORELINE_NO_SEED -1e9f
+
+// split rows [0, count) over the pool, or run them here without one
+static void for_rows(ThreadPool *pool, int count, int grain, const std::function<void(int, int)> &body) {
+    if (pool) {
+        pool->parallel_for(count, grain, body);
+    } else {
+        body(0, count);
+    }
+}
+
+// replace the seeds of n points in a row at grid row y, the first in column
+// x, by candidates that are closer. the quiet isless, unlike <, doesn't stop
+// gcc from turning the selects into blends
+static void relax_row(int n, float x, float y, const float *__restrict candidate_x,
+        const float *__restrict candidate_y, float *__restrict best_x, float *__restrict best_y,
+        float *__restrict best_distance) {
+    for (int i=0; i<n; i++) {
+        float cx = candidate_x[i], cy = candidate_y[i];
+        float bx = best_x[i], by = best_y[i], bd = best_distance[i];
+        float dx = x + i - cx, dy = y - cy;
+        float distance = dx*dx + dy*dy;
+        bool closer = isless(distance, bd);
+        best_x[i] = closer ? cx : bx;
+        best_y[i] = closer ? cy : by;
+        best_distance[i] = closer ? distance : bd;
+    }
+}
+
+void ShorelineField::build(Heightfield &terrain, float water_level, float max_distance, ThreadPool *pool) {
+    PROFILE_ZONE("shoreline_build");
+    columns = terrain.columns;
+    rows = terrain.rows;
+    origin_x = terrain.origin_x;
+    origin_y = terrain.origin_y;
+    spacing = terrain.spacing;
+    this->water_level = water_level;
+    this->max_distance = max_distance;
+    distances.assign((size_t)columns*rows, 0);
+    flood(terrain, 0, 0, columns, rows, 0, 0, columns, rows, pool);
+}
+
+void ShorelineField::update(Heightfield &terrain, int i0, int j0, int i1, int j1, ThreadPool *pool) {
+    PROFILE_ZONE("shoreline_update");
+    if (max_distance <= 0) {
+        flood(terrain, 0, 0, columns, rows, 0, 0, columns, rows, pool);
+        return;
+    }
+
+    // crossings move on the edges touching changed points, which changes
+    // the seeds one point further out. the distances that can change are
+    // those within max_distance of them, and only crossings within
+    // max_distance of those points can be their nearest
+    int reach = (int)ceilf(max_distance / spacing) + 1;
+    int out_x0 = std::max(i0 - 1 - reach, 0), out_y0 = std::max(j0 - 1 - reach, 0);
+    int out_x1 = std::min(i1 + 1 + reach, columns), out_y1 = std::min(j1 + 1 + reach, rows);
+    if (out_x0 >= out_x1 || out_y0 >= out_y1) {
+        return;
+    }
+    flood(terrain, std::max(out_x0 - reach, 0), std::max(out_y0 - reach, 0),
+            std::min(out_x1 + reach, columns), std::min(out_y1 + reach, rows),
+            out_x0, out_y0, out_x1, out_y1, pool);
+}
+
+void ShorelineField::flood(Heightfield &terrain, int x0, int y0, int x1, int y1,
+        int out_x0, int out_y0, int out_x1, int out_y1, ThreadPool *pool) {
+    int width = x1 - x0, height = y1 - y0;
+    size_t count = (size_t)width*height;
+    for (int b=0; b<2; b++) {
+        seed_x[b].resize(count);
+        seed_y[b].resize(count);
+    }
+    // a few rows per chunk, each is a short pass
+    int grain = std::max(1, 8192 / width);
+
+    // seed every point next to the coast with the nearest crossing on the
+    // edges to its four neighbours, interpolated between the two heights
+    for_rows(pool, height, grain, [&](int begin, int end) {
+        static const int offsets[4][2] = { {1, 0}, {-1, 0}, {0, 1}, {0, -1} };
+        for (int r=begin; r<end; r++) {
+            int j = y0 + r;
+            for (int c=0; c<width; c++) {
+                int i = x0 + c;
+                float h = terrain.heights[terrain.index(i, j)];
+                bool land = h >= water_level;
+                float best = FLT_MAX, sx = SHORELINE_NO_SEED, sy = SHORELINE_NO_SEED;
+                for (int n=0; n<4; n++) {
+                    int ni = i + offsets[n][0], nj = j + offsets[n][1];
+                    if (ni < 0 || ni >= columns || nj < 0 || nj >= rows) {
+                        continue;
+                    }
+                    float neighbour = terrain.heights[terrain.index(ni, nj)];
+                    if ((neighbour >= water_level) == land) {
+                        continue;
+                    }
+                    float t = (water_level - h) / (neighbour - h);
+                    if (t < best) {
+                        best = t;
+                        sx = i + t*offsets[n][0];
+                        sy = j + t*offsets[n][1];
+                    }
+                }
+                seed_x[0][(size_t)r*width + c] = sx;
+                seed_y[0][(size_t)r*width + c] = sy;
+            }
+        }
+    });
+
+    // jump flooding: every point takes the closest seed of the points
+    // step away in the eight directions, halving the step down to 1, then
+    // one more pass of 1 to fix most of the points it gets wrong. the
+    // first step only has to reach the farthest distance that matters
+    int reach = std::max(width, height);
+    if (max_distance > 0) {
+        reach = std::min(reach, (int)ceilf(max_distance / spacing) + 1);
+    }
+    int first = 1;
+    while (2*first - 1 < reach) {
+        first *= 2;
+    }
+    std::vector<int> steps;
+    for (int step=first; step>=1; step/=2) {
+        steps.push_back(step);
+    }
+    steps.push_back(1);
+
+    int source = 0;
+    for (size_t pass=0; pass<steps.size(); pass++) {
+        int step = steps[pass];
+        const std::vector<float> &from_x = seed_x[source], &from_y = seed_y[source];
+        std::vector<float> &to_x = seed_x[1 - source], &to_y = seed_y[1 - source];
+
+        for_rows(pool, height, grain, [&](int begin, int end) {
+            std::vector<float> best_distance(width);
+            for (int r=begin; r<end; r++) {
+                size_t row = (size_t)r*width;
+                float y = y0 + r;
+                for (int c=0; c<width; c++) {
+                    to_x[row + c] = from_x[row + c];
+                    to_y[row + c] = from_y[row + c];
+                    float dx = x0 + c - to_x[row + c], dy = y - to_y[row + c];
+                    best_distance[c] = dx*dx + dy*dy;
+                }
+                for (int oy=-step; oy<=step; oy+=step) {
+                    int sr = r + oy;
+                    if (sr < 0 || sr >= height) {
+                        continue;
+                    }
+                    for (int ox=-step; ox<=step; ox+=step) {
+                        if (ox == 0 && oy == 0) {
+                            continue;
+                        }
+                        int c0 = std::max(0, -ox), c1 = std::min(width, width - ox);
+                        if (c0 >= c1) {
+                            continue;
+                        }
+                        size_t from = (size_t)sr*width + c0 + ox;
+                        relax_row(c1 - c0, x0 + c0, y, &from_x[from], &from_y[from],
+                                &to_x[row + c0], &to_y[row + c0], &best_distance[c0]);
+                    }
+                }
+            }
+        });
+        source = 1 - source;
+    }
+
+    const std::vector<float> &final_x = seed_x[source], &final_y = seed_y[source];
+    float limit = max_distance > 0 ? max_distance : FLT_MAX;
+    for_rows(pool, out_y1 - out_y0, grain, [&](int begin, int end) {
+        for (int j=out_y0 + begin; j<out_y0 + end; j++) {
+            for (int i=out_x0; i<out_x1; i++) {
+                size_t cell = (size_t)(j - y0)*width + (i - x0);
+                float dx = i - final_x[cell], dy = j - final_y[cell];
+                float distance = std::min(sqrtf(dx*dx + dy*dy)*spacing, limit);
+                bool land = terrain.heights[terrain.index(i, j)] >= water_level;
+                distances[index(i, j)] = land ? -distance : distance;
+            }
+        }
+    });
+}
+
+float ShorelineField::sample(float x, float y) {
+    float u = (x - origin_x) / spacing, v = (y - origin_y) / spacing;
+    u = std::min(std::max(u, 0.0f), columns - 1.0f);
+    v = std::min(std::max(v, 0.0f), rows - 1.0f);
+    // the last cell for points on the far edges
+    int i = std::min((int)u, columns - 2), j = std::min((int)v, rows - 2);
+    float tu = u - i, tv = v - j;
+
+    float a = distances[index(i, j)], b = distances[index(i+1, j)];
+    float c = distances[index(i, j+1)], d = distances[index(i+1, j+1)];
+    return (a*(1 - tu) + b*tu)*(1 - tv) + (c*(1 - tu) + d*tu)*tv;
+}
@@ -0,0 +1,53 @@
+#ifndef SHORELINE_H
+#define SHORELINE_H
+
+#include "heightfield.h"
+#include "thread_pool.h"
+#include <vector>
+
+// signed distance from every point of a heightfield to the coastline, where
+// the terrain crosses the water level, for damping waves near the shore.
+// built by jump flooding the crossing points found between grid points, so
+// distances are measured to the interpolated coast rather than to grid points
+class ShorelineField {
+    public:
+        // the layout of the heightfield it was built from
+        int columns = 0, rows = 0;
+        float origin_x = 0, origin_y = 0, spacing = 1;
+        float water_level = 0;
+        // world units distances are clamped to, 0 for no limit
+        float max_distance = 0;
+
+        // world distances row after row, positive over water and negative on
+        // land
+        std::vector<float> distances;
+
+        ShorelineField() {}
+
+        // the distances over the whole terrain. a max_distance also bounds
+        // the flood, the shorter the cheaper
+        void build(Heightfield &terrain, float water_level, float max_distance = 0, ThreadPool *pool = NULL);
+        // redo the distances that can have changed after the terrain heights
+        // in columns [i0, i1) and rows [j0, j1) did, e.g. one regenerated
+        // tile. only the rectangle grown by max_distance is flooded, so with
+        // no limit this is a full build
+        void update(Heightfield &terrain, int i0, int j0, int i1, int j1, ThreadPool *pool = NULL);
+
+        // bilinear distance at world (x, y), clamped to the grid
+        float sample(float x, float y);
+
+        int index(int i, int j) { return j*columns + i; }
+
+    private:
+        // closest crossing found so far for every point of the window being
+        // flooded, in grid coordinates, ping-ponged between passes
+        std::vector<float> seed_x[2], seed_y[2];
+
+        // flood the window [x0, x1) x [y0, y1) with the crossings inside it
+        // and write the distances of the points in [out_x0, out_x1) x
+        // [out_y0, out_y1)
+        void flood(Heightfield &terrain, int x0, int y0, int x1, int y1,
+                int out_x0, int out_y0, int out_x1, int out_y1, ThreadPool *pool);
+};
+
+#endif // SHORELINE_H
@@ -0,0 +1,15 @@
+#version 400 compatibility
+
+in vec3 normal;
+in vec4 pos;
+
+void main() {
+  vec4 lpos = gl_LightSource[1].position;
+  vec3 light = normalize(lpos.xyz - pos.xyz);
+  vec3 n = normalize(normal);
+
+  // same flat light color as fshader1.frag, with a little diffuse shading so
+  // the extra detail is visible in fill mode
+  float diffuse = 0.5 + 0.5*max(0.0, dot(n, light));
+  gl_FragColor = gl_LightSource[1].diffuse * diffuse;
+}
@@ -0,0 +1,12 @@
+#version 400 compatibility
+
+// patch corners are passed through in object space, the evaluation shader
+// does the displacement and projection
+
+// lowest and highest terrain height under the patch
+out vec2 height_range;
+
+void main() {
+  gl_Position = gl_Vertex;
+  height_range = gl_MultiTexCoord0.xy;
+}
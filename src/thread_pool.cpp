@@ -0,0 +1,94 @@
+#include "thread_pool.h"
+#include <algorithm>
+
+ThreadPool::ThreadPool(int threads): next_chunk(0) {
+    if (threads <= 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    for (int i=1; i<threads; i++) {
+        workers.push_back(std::thread(&ThreadPool::worker_loop, this));
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (size_t i=0; i<workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+int ThreadPool::get_thread_count() {
+    return workers.size() + 1;
+}
+
+void ThreadPool::run_chunks() {
+    int chunks = (count + grain - 1) / grain;
+    while (true) {
+        int chunk = next_chunk.fetch_add(1, std::memory_order_relaxed);
+        if (chunk >= chunks) {
+            return;
+        }
+        int begin = chunk * grain;
+        (*body)(begin, std::min(count, begin + grain));
+    }
+}
+
+void ThreadPool::worker_loop() {
+    unsigned long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait(lock, [&] { return stopping || generation != seen; });
+            if (stopping) {
+                return;
+            }
+            seen = generation;
+        }
+
+        run_chunks();
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished_workers++;
+        }
+        done.notify_one();
+    }
+}
+
+void ThreadPool::parallel_for(int count, int grain, const std::function<void(int, int)> &body) {
+    if (count <= 0) {
+        return;
+    }
+    grain = std::max(1, grain);
+    if (workers.empty() || count <= grain) {
+        body(0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        this->body = &body;
+        this->count = count;
+        this->grain = grain;
+        next_chunk.store(0, std::memory_order_relaxed);
+        finished_workers = 0;
+        generation++;
+    }
+    wake.notify_all();
+
+    run_chunks();
+
+    // workers that woke up late find no chunks left and finish right away
+    std::unique_lock<std::mutex> lock(mutex);
+    done.wait(lock, [&] { return finished_workers == workers.size(); });
+    this->body = NULL;
+}
+
+ThreadPool &default_thread_pool() {
+    static ThreadPool pool;
+    return pool;
+}
@@ -0,0 +1,55 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// a fixed set of worker threads that split loops between them. workers stay
+// alive between loops, so a parallel_for costs a wake-up rather than thread
+// creation and can be used every frame
+class ThreadPool {
+    private:
+        std::vector<std::thread> workers;
+        std::mutex mutex;
+        std::condition_variable wake, done;
+
+        // the loop being run, guarded by mutex except for the atomics
+        const std::function<void(int, int)> *body = NULL;
+        int count = 0, grain = 1;
+        std::atomic<int> next_chunk;
+        // workers done with the current loop, every worker checks in for
+        // every loop so none can wake late into the next one
+        size_t finished_workers = 0;
+        unsigned long generation = 0;
+        bool stopping = false;
+
+        void worker_loop();
+        // take chunks of the current loop until none are left
+        void run_chunks();
+
+    public:
+        // threads <= 0 uses every hardware thread, the calling thread counts as one
+        ThreadPool(int threads = 0);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        // threads taking part in a loop, including the caller
+        int get_thread_count();
+
+        // call body(begin, end) over [0, count) in chunks of at most grain
+        // items, spread over the pool and the calling thread. returns once
+        // every chunk is done. chunks may run in any order and on any
+        // thread, so body must not depend on either
+        void parallel_for(int count, int grain, const std::function<void(int, int)> &body);
+};
+
+// a pool shared by everything that doesn't need its own, created on first use
+ThreadPool &default_thread_pool();
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,90 @@
+#include "trace.h"
+#include "logger.h"
+#include <stdio.h>
+
+TraceRecorder trace;
+
+// names are ours, but keep the JSON valid whatever they contain
+static void write_json_string(FILE *file, const std::string &str) {
+    fputc('"', file);
+    for (size_t i=0; i<str.size(); i++) {
+        char c = str[i];
+        if (c == '"' || c == '\\') {
+            fputc('\\', file);
+            fputc(c, file);
+        } else if ((unsigned char)c < 0x20) {
+            fprintf(file, "\\u%04x", c);
+        } else {
+            fputc(c, file);
+        }
+    }
+    fputc('"', file);
+}
+
+void TraceRecorder::start() {
+    recording = true;
+    events.reserve(64*1024);
+    profiler.set_enabled(true);
+}
+
+bool TraceRecorder::is_recording() {
+    return recording;
+}
+
+void TraceRecorder::sink(const ZoneBuffer &buffer, const ZoneEvent &event) {
+    trace.add(buffer, event);
+}
+
+void TraceRecorder::add(const ZoneBuffer &buffer, const ZoneEvent &event) {
+    if (!recording) {
+        return;
+    }
+    if (events.size() >= TRACE_MAX_EVENTS) {
+        if (!full) {
+            log("trace is full after %d events, later events are not recorded\n", TRACE_MAX_EVENTS);
+            full = true;
+        }
+        return;
+    }
+
+    Event recorded;
+    recorded.zone = event;
+    recorded.thread_index = buffer.thread_index;
+    events.push_back(recorded);
+
+    if (thread_names.size() <= buffer.thread_index) {
+        thread_names.resize(buffer.thread_index + 1);
+    }
+    thread_names[buffer.thread_index] = buffer.thread_name;
+}
+
+bool TraceRecorder::write(const std::string &path) {
+    FILE *file = fopen(path.c_str(), "w");
+    if (!file) {
+        log("could not write trace %s\n", path.c_str());
+        return false;
+    }
+
+    fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Ocean-breeze\"}}");
+    for (size_t i=0; i<thread_names.size(); i++) {
+        fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%zu,\"args\":{\"name\":", i);
+        write_json_string(file, thread_names[i]);
+        fprintf(file, "}}");
+    }
+
+    // complete events carry their begin and duration, timestamps are microseconds
+    for (size_t i=0; i<events.size(); i++) {
+        const Event &event = events[i];
+        fprintf(file, ",\n{\"name\":");
+        write_json_string(file, profiler.zone_name(event.zone.zone));
+        fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                event.thread_index, event.zone.begin_ns / 1e3,
+                (event.zone.end_ns - event.zone.begin_ns) / 1e3);
+    }
+    fprintf(file, "\n]}\n");
+
+    bool ok = fclose(file) == 0;
+    log("wrote %zu trace events to %s\n", events.size(), path.c_str());
+    return ok;
+}
@@ -0,0 +1,43 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include "profiler.h"
+#include <string>
+#include <vector>
+
+// events kept before recording stops, about 24MB
+#define TRACE_MAX_EVENTS 1000000
+
+// keeps the profiler's zones as a timeline and writes them in the Chrome
+// trace event format, which chrome://tracing and Perfetto open directly
+class TraceRecorder {
+    private:
+        struct Event {
+            ZoneEvent zone;
+            uint32_t thread_index;
+        };
+
+        bool recording = false;
+        bool full = false;
+        std::vector<Event> events;
+        // thread names by index, as of the last collected event
+        std::vector<std::string> thread_names;
+
+    public:
+        TraceRecorder() {}
+
+        // start keeping events, also turns on the profiler zones
+        void start();
+        bool is_recording();
+
+        // profiler sink, pass to Profiler::collect
+        static void sink(const ZoneBuffer &buffer, const ZoneEvent &event);
+        void add(const ZoneBuffer &buffer, const ZoneEvent &event);
+
+        // write everything recorded so far, recording carries on
+        bool write(const std::string &path);
+};
+
+extern TraceRecorder trace;
+
+#endif // TRACE_H
@@ -2,13 +2,54 @@ varying vec3 normal;
 varying vec4 pos;
 varying vec4 rawpos;
 
-uniform float angle;
+// the Gerstner wave bank, laid out by GerstnerBank::pack_uniforms: two
+// entries per wave, (kx, ky, amplitude, steepness/k) and (steepness, 0, 0,
+// 0). 32 is 2*GERSTNER_MAX_WAVES
+uniform vec4 waves[32];
+uniform int wave_count;
+// the time dependent part of each wave's phase, reduced on the CPU by
+// GerstnerBank::phase_offsets every frame so float keeps up with long runs
+uniform float wave_phase[16];
+
+// displacement of the point at rest at p and the normal of the displaced
+// surface over ground of slope (dz/dx, dz/dy), the same sums as
+// GerstnerBank::evaluate. the tangents along x and y are
+// (1 - sxx, -sxy, dz/dx) and (-sxy, 1 - syy, dz/dy)
+vec3 gerstner(vec2 p, vec2 ground_slope, out vec3 surface_normal) {
+  vec3 offset = vec3(0.0);
+  vec2 slope = ground_slope;
+  vec3 steep = vec3(0.0);
+  for (int i = 0; i < 16; i++) {
+    if (i >= wave_count) {
+      break;
+    }
+    vec4 a = waves[2*i];
+    vec4 b = waves[2*i + 1];
+    float theta = dot(a.xy, p) + wave_phase[i];
+    float s = sin(theta);
+    float c = cos(theta);
+    vec2 direction = normalize(a.xy);
+    offset += vec3(direction*a.w*c, a.z*s);
+    // k*amplitude*direction*cos and steepness*(dx*dx, dx*dy, dy*dy)*sin
+    slope += a.xy*a.z*c;
+    steep += b.x*s*direction.xxy*direction.xyy;
+  }
+  float tx = 1.0 - steep.x;
+  float ty = 1.0 - steep.z;
+  surface_normal = normalize(vec3(-steep.y*slope.y - slope.x*ty,
+                                  -slope.x*steep.y - tx*slope.y,
+                                  tx*ty - steep.y*steep.y));
+  return offset;
+}
 
 void main() {
   vec4 v = vec4(gl_Vertex);
-  v.z = v.z + sin(2.0*v.x + angle)*0.2;
+  // the CPU normal is the terrain's, its slopes ride under the waves
+  vec2 ground_slope = -gl_Normal.xy / gl_Normal.z;
+  vec3 surface_normal;
+  v.xyz = v.xyz + gerstner(v.xy, ground_slope, surface_normal);
 
-  normal = gl_NormalMatrix * gl_Normal;
+  normal = gl_NormalMatrix * surface_normal;
   gl_Position = gl_ModelViewProjectionMatrix * v;
   pos = gl_ModelViewMatrix * v;
   rawpos = v;
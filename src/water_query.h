@@ -0,0 +1,42 @@
+#ifndef WATER_QUERY_H
+#define WATER_QUERY_H
+
+#include <stddef.h>
+#include <vector>
+
+// the water surface above a batch of world points, for buoyancy and other
+// gameplay queries. structure of arrays so the wave models fill it with
+// loops that vectorize. keep one around between frames to reuse its memory
+struct WaterQuery {
+    // world points, set before querying
+    std::vector<float> x, y;
+
+    // surface height and unit normal above each point
+    std::vector<float> height, normal_x, normal_y, normal_z;
+    // the waves move surface points sideways too, this is where the point
+    // that ended up above the query point sits at rest
+    std::vector<float> rest_x, rest_y;
+
+    void add(float px, float py) {
+        x.push_back(px);
+        y.push_back(py);
+    }
+    void clear() {
+        x.clear();
+        y.clear();
+    }
+    size_t size() { return x.size(); }
+
+    // size the outputs to the points
+    void resize_outputs() {
+        size_t count = x.size();
+        height.resize(count);
+        normal_x.resize(count);
+        normal_y.resize(count);
+        normal_z.resize(count);
+        rest_x.resize(count);
+        rest_y.resize(count);
+    }
+};
+
+#endif // WATER_QUERY_H
@@ -0,0 +1,98 @@
+#include "worley.h"
+#include "fast_math.h"
+#include "pnoise.h"
+#include <algorithm>
+
+// points evaluated at a time, the search keeps a few values per point on
+// the stack
+#define WORLEY_BLOCK 64
+
+// the 3x3 cells around a point's cell, its own first and the corners last
+// since they are the furthest away
+static const int WORLEY_CELLS[9][2] = {
+    { 0, 0 }, { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 },
+    { -1, -1 }, { 1, -1 }, { -1, 1 }, { 1, 1 }
+};
+
+// how many points of the run could have a feature point in the cell at
+// (dx, dy) from their own closer than limit, both squared. the cell is at
+// least the distance to the walls between them away
+static int closer_count(int n, int dx, int dy,
+        const float *__restrict fx, const float *__restrict fy, const float *__restrict limit) {
+    float left = dx < 0, right = dx > 0, down = dy < 0, up = dy > 0;
+    int count = 0;
+    for (int i=0; i<n; i++) {
+        float ex = left*fx[i] + right*(1 - fx[i]);
+        float ey = down*fy[i] + up*(1 - fy[i]);
+        count += ex*ex + ey*ey < limit[i];
+    }
+    return count;
+}
+
+// the squared distances to the feature point of the cell at (dx, dy) from
+// every point's own, kept if they are among the two nearest so far
+static void search_cell(int n, int dx, int dy, uint32_t seed,
+        const int *__restrict cx, const int *__restrict cy,
+        const float *__restrict fx, const float *__restrict fy,
+        float *__restrict f1, float *__restrict f2) {
+    for (int i=0; i<n; i++) {
+        uint32_t h = hash2D(cx[i] + dx, cy[i] + dy, seed);
+        float px = dx + (h & 0xffff)*(1.0f/65536.0f) - fx[i];
+        float py = dy + (h >> 16)*(1.0f/65536.0f) - fy[i];
+        float d = px*px + py*py;
+        f2[i] = std::min(f2[i], std::max(f1[i], d));
+        f1[i] = std::min(f1[i], d);
+    }
+}
+
+void WorleyNoise::get_heights2D(int count, const float *x, const float *y, float *heights) {
+    // locals, the stores below could otherwise alias the members
+    float scale = amplitude, inverse = 1 / wavelength;
+    uint32_t cell_seed = seed;
+    WorleyMode distances = mode;
+
+    for (int first=0; first<count; first+=WORLEY_BLOCK) {
+        int n = std::min(count - first, WORLEY_BLOCK);
+        const float *__restrict bx = x + first;
+        const float *__restrict by = y + first;
+        float *__restrict out = heights + first;
+        // each point's cell, where in it the point is and the squared
+        // distances to the nearest two feature points so far
+        int cx[WORLEY_BLOCK], cy[WORLEY_BLOCK];
+        float fx[WORLEY_BLOCK], fy[WORLEY_BLOCK], f1[WORLEY_BLOCK], f2[WORLEY_BLOCK];
+        for (int i=0; i<n; i++) {
+            float u = bx[i]*inverse, v = by[i]*inverse;
+            cx[i] = floor_fast(u);
+            cy[i] = floor_fast(v);
+            fx[i] = u - cx[i];
+            fy[i] = v - cy[i];
+            // further than any point of the 3x3 cells
+            f1[i] = 9.0f;
+            f2[i] = 9.0f;
+        }
+
+        // F1 only needs cells that can beat the nearest point
+        const float *limit = distances == WORLEY_F1 ? f1 : f2;
+        for (int k=0; k<9; k++) {
+            int dx = WORLEY_CELLS[k][0], dy = WORLEY_CELLS[k][1];
+            if (k > 0 && closer_count(n, dx, dy, fx, fy, limit) == 0) {
+                continue;
+            }
+            search_cell(n, dx, dy, cell_seed, cx, cy, fx, fy, f1, f2);
+        }
+
+        if (distances == WORLEY_F1) {
+            for (int i=0; i<n; i++) out[i] = scale*sqrt_fast(f1[i]);
+        } else if (distances == WORLEY_F2) {
+            for (int i=0; i<n; i++) out[i] = scale*sqrt_fast(f2[i]);
+        } else {
+            for (int i=0; i<n; i++) out[i] = scale*(sqrt_fast(f2[i]) - sqrt_fast(f1[i]));
+        }
+    }
+}
+
+float WorleyNoise::get_height2D(float x, float y) {
+    float height;
+    get_heights2D(1, &x, &y, &height);
+    return height;
+}
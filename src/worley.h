@@ -0,0 +1,44 @@
+#ifndef WORLEY_H
+#define WORLEY_H
+
+#include <stdint.h>
+
+// which distances a WorleyNoise returns: to the nearest feature point, to
+// the second nearest, or their difference, which is 0 along the cell walls
+enum WorleyMode { WORLEY_F1, WORLEY_F2, WORLEY_F2_MINUS_F1 };
+
+// cellular noise: every lattice cell holds one feature point at a hashed
+// position and the noise is the distance to the nearest ones, times the
+// amplitude. distances are in cells, so F1 stays under about 1.2. the 3x3
+// cells around a point are searched, as usual, so a point two cells away is
+// very rarely missed, more often for F2 than F1
+class WorleyNoise {
+    private:
+        // wavelength is the size of a cell in world units
+        float amplitude = 1.0f, wavelength = 1.0f;
+        uint32_t seed = 0;
+        WorleyMode mode = WORLEY_F1;
+
+    public:
+        WorleyNoise() {}
+
+        // getters
+        float get_amplitude() { return amplitude; }
+        float get_wavelength() { return wavelength; }
+        uint32_t get_seed() { return seed; }
+        WorleyMode get_mode() { return mode; }
+
+        // setters
+        void set_amplitude(float amp) { amplitude = amp; }
+        void set_wavelength(float wav) { wavelength = wav; }
+        void set_seed(uint32_t s) { seed = s; }
+        void set_mode(WorleyMode m) { mode = m; }
+
+        float get_height2D(float x, float y);
+        // the noise at count points, a block at a time. the cells of the
+        // block are searched in one vectorized pass each, nearest first, and
+        // a cell no point in the block can get closer to is skipped
+        void get_heights2D(int count, const float *x, const float *y, float *heights);
+};
+
+#endif // WORLEY_H
@@ -0,0 +1,135 @@
+#include "logger.h"
+#include "ocean_loop.h"
+#include "thread_pool.h"
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PI 3.14159265359
+
+// bakes a looping FFT ocean to a file of quantized frames that the app
+// plays back with --ocean-loop
+
+struct OceanBakeOptions {
+    OceanParameters parameters;
+    int frames = 64;
+    int bits = 16;
+    int threads = 0;
+    const char *output = NULL;
+};
+
+static void print_usage(const char *program) {
+    fprintf(stderr,
+        "usage: %s [options] <output>\n"
+        "  --size <n>                  grid points per side, a power of two from 64 to 1024 (default 256)\n"
+        "  --length <l>                world units covered by one tile (default 10)\n"
+        "  --wind <speed> <degrees>    wind speed and direction (default 3 0)\n"
+        "  --spectrum <phillips|jonswap>  wave spectrum (default phillips)\n"
+        "  --fetch <f>                 distance the wind blew over water, for jonswap (default 50)\n"
+        "  --height <h>                RMS height of the surface (default 0.1)\n"
+        "  --choppiness <c>            horizontal displacement scale (default 1)\n"
+        "  --seed <n>                  spectrum seed (default 0)\n"
+        "  --period <seconds>          length of the loop (default 8)\n"
+        "  --frames <n>                frames baked over the period (default 64)\n"
+        "  --bits <8|16>               bits per stored sample (default 16)\n"
+        "  --threads <n>               worker threads, 0 for every core (default 0)\n"
+        "  --help                      show this message\n"
+        "\n"
+        "every wave frequency is rounded to a whole number of cycles per period\n"
+        "so the last frame blends seamlessly into the first\n",
+        program);
+}
+
+static bool parse_bake_options(int argc, char **argv, OceanBakeOptions &options) {
+    OceanParameters &parameters = options.parameters;
+    parameters.loop_period = 8.0f;
+    for (int i=1; i<argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--size") == 0 && i + 1 < argc) {
+            parameters.size = atoi(argv[++i]);
+        } else if (strcmp(arg, "--length") == 0 && i + 1 < argc) {
+            parameters.length = atof(argv[++i]);
+        } else if (strcmp(arg, "--wind") == 0 && i + 2 < argc) {
+            parameters.wind_speed = atof(argv[++i]);
+            parameters.wind_direction = atof(argv[++i]) * PI / 180;
+        } else if (strcmp(arg, "--spectrum") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            if (strcmp(name, "phillips") == 0) {
+                parameters.spectrum = SPECTRUM_PHILLIPS;
+            } else if (strcmp(name, "jonswap") == 0) {
+                parameters.spectrum = SPECTRUM_JONSWAP;
+            } else {
+                fprintf(stderr, "unknown spectrum %s\n", name);
+                return false;
+            }
+        } else if (strcmp(arg, "--fetch") == 0 && i + 1 < argc) {
+            parameters.fetch = atof(argv[++i]);
+        } else if (strcmp(arg, "--height") == 0 && i + 1 < argc) {
+            parameters.height = atof(argv[++i]);
+        } else if (strcmp(arg, "--choppiness") == 0 && i + 1 < argc) {
+            parameters.choppiness = atof(argv[++i]);
+        } else if (strcmp(arg, "--seed") == 0 && i + 1 < argc) {
+            parameters.seed = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "--period") == 0 && i + 1 < argc) {
+            parameters.loop_period = atof(argv[++i]);
+        } else if (strcmp(arg, "--frames") == 0 && i + 1 < argc) {
+            options.frames = atoi(argv[++i]);
+        } else if (strcmp(arg, "--bits") == 0 && i + 1 < argc) {
+            options.bits = atoi(argv[++i]);
+        } else if (strcmp(arg, "--threads") == 0 && i + 1 < argc) {
+            options.threads = atoi(argv[++i]);
+        } else if (arg[0] != '-' && !options.output) {
+            options.output = arg;
+        } else {
+            if (strcmp(arg, "--help") != 0) {
+                fprintf(stderr, "unknown argument %s\n", arg);
+            }
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+
+    if (!options.output) {
+        print_usage(argv[0]);
+        return false;
+    }
+    int size = parameters.size;
+    if (size < 64 || size > 1024 || (size & (size - 1)) != 0) {
+        fprintf(stderr, "the size must be a power of two from 64 to 1024\n");
+        return false;
+    }
+    if (parameters.length <= 0 || parameters.loop_period <= 0 || options.frames < 2) {
+        fprintf(stderr, "the length and period must be positive and there must be at least 2 frames\n");
+        return false;
+    }
+    if (options.bits != 8 && options.bits != 16) {
+        fprintf(stderr, "samples are 8 or 16 bits\n");
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char **argv) {
+    OceanBakeOptions options;
+    if (!parse_bake_options(argc, argv, options)) {
+        return 1;
+    }
+
+    ThreadPool pool(options.threads);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (!OceanLoop::bake(options.parameters, options.frames, options.bits, options.output, &pool)) {
+        log("could not write %s\n", options.output);
+        return 1;
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int size = options.parameters.size;
+    double megabytes = (double)options.frames * 5 * size * size * options.bits / 8 / (1 << 20);
+    log("baked %d frames of %dx%d over %g s in %.3f s on %d threads, %.1f MB\n",
+            options.frames, size, size, options.parameters.loop_period, seconds,
+            pool.get_thread_count(), megabytes);
+    log("wrote %s\n", options.output);
+    return 0;
+}
@@ -0,0 +1,238 @@
+#include "erosion.h"
+#include "heightfield.h"
+#include "image_io.h"
+#include "logger.h"
+#include "noise_graph.h"
+#include "pnoise.h"
+#include "thread_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+// bakes a heightfield to a file without a window or GL context, for asset
+// pipelines running on servers
+
+enum Format {FORMAT_AUTO, FORMAT_RAW, FORMAT_PGM, FORMAT_PNG, FORMAT_OHF};
+
+struct BakeOptions {
+    uint32_t seed = 0;
+    float amplitude = 1.0f;
+    float wavelength = 1.0f;
+    float warp_strength = 0, warp_wavelength = 1.0f;
+    float origin_x = 0, origin_y = 0;
+    // world width covered by the columns, rows use the same spacing
+    float extent = 16.0f;
+    int columns = 1024, rows = 0;
+    int threads = 0;
+    // a noise graph file generating the heights instead of the noise
+    const char *graph = NULL;
+    // erosion iterations run over the noise, 0 for none
+    int erode = 0;
+    Format format = FORMAT_AUTO;
+    const char *output = NULL;
+};
+
+static void print_usage(const char *program) {
+    fprintf(stderr,
+        "usage: %s [options] <output>\n"
+        "  --seed <n>                  noise seed (default 0)\n"
+        "  --amplitude <a>             noise amplitude (default 1)\n"
+        "  --wavelength <w>            world distance between noise lattice points (default 1)\n"
+        "  --warp <s> <w>              move the samples by s times noise of wavelength w (default 0, off)\n"
+        "  --graph <file>              generate the heights from a noise graph, the noise options don't apply\n"
+        "  --origin <x> <y>            world position of the first sample (default 0 0)\n"
+        "  --extent <width>            world width covered by the columns (default 16)\n"
+        "  --resolution <cols> [rows]  samples per row and column (default 1024, rows default to cols)\n"
+        "  --format <raw|pgm|png|ohf>  output format, by default taken from the output extension\n"
+        "  --erode <iterations>        erode the noise with rain and landslides (default 0)\n"
+        "  --threads <n>               worker threads, 0 for every core (default 0)\n"
+        "  --help                      show this message\n"
+        "\n"
+        "raw writes native endian floats, pgm and png 16-bit samples normalized\n"
+        "to the baked height range, ohf the binary heightfield cache format\n",
+        program);
+}
+
+static Format parse_format(const char *name) {
+    if (strcmp(name, "raw") == 0) return FORMAT_RAW;
+    if (strcmp(name, "pgm") == 0) return FORMAT_PGM;
+    if (strcmp(name, "png") == 0) return FORMAT_PNG;
+    if (strcmp(name, "ohf") == 0) return FORMAT_OHF;
+    return FORMAT_AUTO;
+}
+
+static bool parse_bake_options(int argc, char **argv, BakeOptions &options) {
+    for (int i=1; i<argc; i++) {
+        const char *arg = argv[i];
+        if (strcmp(arg, "--seed") == 0 && i + 1 < argc) {
+            options.seed = strtoul(argv[++i], NULL, 10);
+        } else if (strcmp(arg, "--amplitude") == 0 && i + 1 < argc) {
+            options.amplitude = atof(argv[++i]);
+        } else if (strcmp(arg, "--wavelength") == 0 && i + 1 < argc) {
+            options.wavelength = atof(argv[++i]);
+        } else if (strcmp(arg, "--warp") == 0 && i + 2 < argc) {
+            options.warp_strength = atof(argv[++i]);
+            options.warp_wavelength = atof(argv[++i]);
+        } else if (strcmp(arg, "--graph") == 0 && i + 1 < argc) {
+            options.graph = argv[++i];
+        } else if (strcmp(arg, "--origin") == 0 && i + 2 < argc) {
+            options.origin_x = atof(argv[++i]);
+            options.origin_y = atof(argv[++i]);
+        } else if (strcmp(arg, "--extent") == 0 && i + 1 < argc) {
+            options.extent = atof(argv[++i]);
+        } else if (strcmp(arg, "--resolution") == 0 && i + 1 < argc) {
+            options.columns = atoi(argv[++i]);
+            if (i + 1 < argc && isdigit((unsigned char)argv[i+1][0])) {
+                options.rows = atoi(argv[++i]);
+            }
+        } else if (strcmp(arg, "--format") == 0 && i + 1 < argc) {
+            options.format = parse_format(argv[++i]);
+            if (options.format == FORMAT_AUTO) {
+                fprintf(stderr, "unknown format %s\n", argv[i]);
+                return false;
+            }
+        } else if (strcmp(arg, "--erode") == 0 && i + 1 < argc) {
+            options.erode = atoi(argv[++i]);
+        } else if (strcmp(arg, "--threads") == 0 && i + 1 < argc) {
+            options.threads = atoi(argv[++i]);
+        } else if (arg[0] != '-' && !options.output) {
+            options.output = arg;
+        } else {
+            if (strcmp(arg, "--help") != 0) {
+                fprintf(stderr, "unknown argument %s\n", arg);
+            }
+            print_usage(argv[0]);
+            return false;
+        }
+    }
+
+    if (!options.output) {
+        print_usage(argv[0]);
+        return false;
+    }
+    if (options.rows <= 0) {
+        options.rows = options.columns;
+    }
+    if (options.columns < 2 || options.rows < 2 || options.extent <= 0 || options.wavelength <= 0
+            || options.warp_wavelength <= 0) {
+        fprintf(stderr, "the grid needs at least 2x2 samples, a positive extent and wavelengths\n");
+        return false;
+    }
+    if (options.format == FORMAT_AUTO) {
+        const char *dot = strrchr(options.output, '.');
+        options.format = dot ? parse_format(dot + 1) : FORMAT_AUTO;
+        if (options.format == FORMAT_AUTO) {
+            fprintf(stderr, "can't tell the format from %s, pass --format\n", options.output);
+            return false;
+        }
+    }
+    return true;
+}
+
+// heights scaled to the full 16-bit range, returns the range through min/max
+static std::vector<uint16_t> quantize(const std::vector<float> &heights, float &min, float &max) {
+    min = heights[0];
+    max = heights[0];
+    for (size_t i=1; i<heights.size(); i++) {
+        min = std::min(min, heights[i]);
+        max = std::max(max, heights[i]);
+    }
+    float scale = max > min ? 65535.0f / (max - min) : 0;
+
+    std::vector<uint16_t> samples(heights.size());
+    for (size_t i=0; i<heights.size(); i++) {
+        samples[i] = (uint16_t)lrintf((heights[i] - min) * scale);
+    }
+    return samples;
+}
+
+int main(int argc, char **argv) {
+    BakeOptions options;
+    if (!parse_bake_options(argc, argv, options)) {
+        return 1;
+    }
+
+    PNoise noise;
+    noise.set_seed(options.seed);
+    noise.set_amplitude(options.amplitude);
+    noise.set_wavelength(options.wavelength);
+    noise.set_warp(options.warp_strength, options.warp_wavelength);
+
+    float spacing = options.extent / (options.columns - 1);
+    Heightfield terrain(options.columns, options.rows, options.origin_x, options.origin_y, spacing);
+
+    NoiseGraph graph;
+    NoiseProgram program;
+    if (options.graph) {
+        if (!graph.load(options.graph) || !program.compile(graph)) {
+            log("could not load the noise graph %s\n", options.graph);
+            return 1;
+        }
+        log("compiled %s to %d instructions over %d registers\n", options.graph,
+                program.get_instruction_count(), program.get_register_count());
+    }
+
+    ThreadPool pool(options.threads);
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    if (options.graph) {
+        program.generate(terrain, pool);
+    } else {
+        terrain.generate(noise, pool);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    log("generated %dx%d samples in %.3f s on %d threads\n",
+            options.columns, options.rows, seconds, pool.get_thread_count());
+
+    if (options.erode > 0) {
+        ErosionParameters parameters;
+        parameters.iterations = options.erode;
+        Erosion erosion;
+        start = std::chrono::steady_clock::now();
+        erosion.erode(terrain, parameters, &pool);
+        seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        log("eroded %d iterations in %.3f s\n", options.erode, seconds);
+    }
+
+    // image rows go top to bottom while the grid's y goes up, so flip them
+    std::vector<float> image(terrain.heights.size());
+    for (int j=0; j<terrain.rows; j++) {
+        memcpy(&image[(size_t)(terrain.rows - 1 - j) * terrain.columns],
+                &terrain.heights[terrain.index(0, j)], terrain.columns * sizeof(float));
+    }
+
+    bool ok = false;
+    switch (options.format) {
+        case FORMAT_RAW:
+            ok = write_raw_floats(options.output, &image[0], image.size());
+            break;
+        case FORMAT_PGM:
+        case FORMAT_PNG: {
+            float min, max;
+            std::vector<uint16_t> samples = quantize(image, min, max);
+            if (options.format == FORMAT_PGM) {
+                ok = write_pgm(options.output, terrain.columns, terrain.rows, 16, &samples[0]);
+            } else {
+                ok = write_png(options.output, terrain.columns, terrain.rows, 1, 16, &samples[0]);
+            }
+            log("heights %g to %g mapped to 0 to 65535\n", min, max);
+            break;
+        }
+        case FORMAT_OHF:
+            ok = terrain.save(options.output);
+            break;
+        case FORMAT_AUTO:
+            break;
+    }
+
+    if (!ok) {
+        log("could not write %s\n", options.output);
+        return 1;
+    }
+    log("wrote %s\n", options.output);
+    return 0;
+}